@@ -39,6 +39,9 @@
 
 /* -------------------------------------------------------------------- */
 
+/* Driver name, also used to recognize screens driven by this driver */
+#define IMX_DRIVER_NAME		"imx"
+
 /* Align an offset to an arbitrary alignment */
 #define IMX_ALIGN(offset, align) 	\
 	(((offset) + (align) - 1) - (((offset) + (align) - 1) % (align)))
@@ -51,6 +54,9 @@ typedef struct {
 	char				fbId[80];
 	char				fbDeviceName[32];
 
+	/* set when the frame buffer device is an EPDC (e-ink) panel */
+	Bool				isEPDC;
+
 	/* virtual addr returned by mmap for FB memory */
 	unsigned char*			fbMemoryBase;
 
@@ -78,8 +84,39 @@ typedef struct {
 	EntityInfoPtr			pEntity;
 	OptionInfoPtr			pOptions;
 	Bool				useAccel;
+	Bool				useAccelComposite;
+	int				accelThreads;
+	const char*			offscreenEviction;
 	void*				exaDriverPrivate;
 	void*				displayPrivate;
+	void*				epdcPrivate;
+
+	/* EPDC shadow; when epdcShadowBpp is set X renders into */
+	/* epdcShadowMemory and damage is converted to the 8-bit gray */
+	/* frame buffer, which has epdcFbPitch bytes per line */
+	int				epdcShadowBpp;
+	unsigned char*			epdcShadowMemory;
+	int				epdcFbPitch;
+
+	/* set for Y8INV frame buffers where 0 is white */
+	Bool				epdcInverted;
+
+	/* dithering of the shadow, to 16 or 2 levels */
+	int				epdcDither;	/* ImxEpdcDitherSelect */
+	int				epdcDitherLevels;
+
+	/* EPDC update engine options */
+	Bool				epdcUpdate;
+	int				epdcMergeWaste;
+	int				epdcMaxUpdates;
+	int				epdcWaveform;	/* ImxEpdcWaveformSelect */
+	int				epdcSmallArea;
+	int				epdcFullRefresh; /* ImxEpdcRefreshSelect */
+	int				epdcRefreshCount;
+	int				epdcRefreshArea;
+	int				epdcRefreshDelay;
+	int				epdcUpdateRate;
+	int				epdcFastPath;
 
 #if IMX_XVIDEO_ENABLE
 	/* for xvideo */
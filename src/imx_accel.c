@@ -21,14 +21,71 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
  * SOFTWARE.
  */
+
+
+/*
+ * Kernel dispatch.
+ *
+ * The kernels in imx_accel_kernels.c are built as portable C and, on ARM,
+ * again for ARM without NEON and for NEON.  imx_accel_init picks the build
+ * matching the CPU from the hwcaps the kernel passes in the auxiliary
+ * vector, so one module runs on i.MX parts with and without NEON and the
+ * same kernels can be built and tested on any Linux host.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <xorg-server.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include "xf86.h"
 #include "imx_accel.h"
 
-extern void* neon_memcpy(void* dest, const void* source, unsigned int numBytes);
-extern void* neon_memmove(void* dest, const void* source, unsigned int numBytes);
+#if defined(IMX_ACCEL_ARM)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_ARM_NEON
+#define	HWCAP_ARM_NEON		(1 << 12)
+#endif
+#endif
+
+static const ImxAccelFuncsRec* imx_accel_funcs = &imx_accel_funcs_c;
+static int imx_accel_copy_bytes = 0;
+
+void
+imx_accel_init(void)
+{
+#if defined(IMX_ACCEL_ARM)
+	const unsigned long hwcap = getauxval(AT_HWCAP);
+
+	if (0 != (hwcap & HWCAP_ARM_NEON)) {
+		imx_accel_funcs = &imx_accel_funcs_neon;
+	} else {
+		imx_accel_funcs = &imx_accel_funcs_arm;
+	}
+#else
+	imx_accel_funcs = &imx_accel_funcs_c;
+#endif
+
+	imx_accel_copy_bytes = (*imx_accel_funcs->copy_calibrate)();
+}
+
+const char*
+imx_accel_name(void)
+{
+	return imx_accel_funcs->name;
+}
+
+int
+imx_accel_copy_threshold(void)
+{
+	return imx_accel_copy_bytes;
+}
+
+/* -------------------------------------------------------------------- */
 
 void
 imx_copy_sw_no_overlap_8(
@@ -39,46 +96,8 @@ imx_copy_sw_no_overlap_8(
 	int pitchDst,
 	int pitchSrc)
 {
-	/* 1 pixel only */
-	if ((1 == width) && (1 == height)) {
-
-		*pBufferDst = *pBufferSrc;
-
-	/* Width matches pitch for src/dst, then copy entire block */
-	} else if ((pitchDst == width) && (pitchSrc == width)) {
-
-		neon_memcpy(pBufferDst, pBufferSrc, width * height);
-
-	/* 1 pixel per row */
-	} else if (1 == width) {
-
-		while (height-- > 0) {
-
-			*pBufferDst = *pBufferSrc;
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
-
-	/* Use neon_memcpy when width big enough */
-	} else if (128 <= width) {
-
-		while (height-- > 0) {
-
-			neon_memcpy(pBufferDst, pBufferSrc, width);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
-
-	/* Fallback to use memcpy. */
-	} else {
-
-		while (height-- > 0) {
-
-			memcpy(pBufferDst, pBufferSrc, width);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
-	}
+	(*imx_accel_funcs->copy_sw_no_overlap_8)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc);
 }
 
 void
@@ -90,55 +109,155 @@ imx_copy_sw_no_overlap_16(
 	int pitchDst,
 	int pitchSrc)
 {
-	/* 1 pixel only */
-	if ((1 == width) && (1 == height)) {
-
-		*(uint16_t*)pBufferDst = *(uint16_t*)pBufferSrc;
-		return;
-	}
-
-	/* How many bytes to copy per row of rectangle? */
-	int rowCopyBytes = width << 1;
+	(*imx_accel_funcs->copy_sw_no_overlap_16)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc);
+}
 
-	/* Width matches pitch for src/dst, then copy entire block */
-	if ((pitchDst == rowCopyBytes) && (pitchSrc == rowCopyBytes)) {
+void
+imx_copy_sw_no_overlap_32(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->copy_sw_no_overlap_32)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc);
+}
 
-		neon_memcpy(pBufferDst, pBufferSrc, rowCopyBytes * height);
+void
+imx_copy_sw_overlap_8(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->copy_sw_overlap_8)(pBufferDst, pBufferSrc, width,
+			height, pitchDst, pitchSrc);
+}
 
-	/* 1 pixel per row */
-	} else if (1 == width) {
+void
+imx_copy_sw_overlap_16(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->copy_sw_overlap_16)(pBufferDst, pBufferSrc, width,
+			height, pitchDst, pitchSrc);
+}
 
-		while (height-- > 0) {
+void
+imx_copy_sw_overlap_32(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->copy_sw_overlap_32)(pBufferDst, pBufferSrc, width,
+			height, pitchDst, pitchSrc);
+}
 
-			*(uint16_t*)pBufferDst = *(uint16_t*)pBufferSrc;
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
+void
+imx_fill_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	(*imx_accel_funcs->fill_sw_8)(pBufferDst, width, height, pitchDst,
+			color);
+}
 
-	/* Use neon_memcpy when width big enough */
-	} else if (64 <= width) {
+void
+imx_fill_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	(*imx_accel_funcs->fill_sw_16)(pBufferDst, width, height, pitchDst,
+			color);
+}
 
-		while (height-- > 0) {
+void
+imx_fill_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	(*imx_accel_funcs->fill_sw_32)(pBufferDst, width, height, pitchDst,
+			color);
+}
 
-			neon_memcpy(pBufferDst, pBufferSrc, rowCopyBytes);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
+void
+imx_fill_pattern_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	(*imx_accel_funcs->fill_pattern_sw_8)(pBufferDst, width, height,
+			pitchDst, pPattern, patternX, patternY);
+}
 
-	/* Fallback to use memcpy. */
-	} else {
+void
+imx_fill_pattern_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	(*imx_accel_funcs->fill_pattern_sw_16)(pBufferDst, width, height,
+			pitchDst, pPattern, patternX, patternY);
+}
 
-		while (height-- > 0) {
+void
+imx_fill_pattern_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	(*imx_accel_funcs->fill_pattern_sw_32)(pBufferDst, width, height,
+			pitchDst, pPattern, patternX, patternY);
+}
 
-			memcpy(pBufferDst, pBufferSrc, rowCopyBytes);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
-	}
+void
+imx_upload_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->upload_sw_8)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
 }
 
 void
-imx_copy_sw_no_overlap_32(
+imx_upload_sw_16(
 	unsigned char* __restrict__ pBufferDst,
 	unsigned char* __restrict__ pBufferSrc,
 	int width,
@@ -146,48 +265,166 @@ imx_copy_sw_no_overlap_32(
 	int pitchDst,
 	int pitchSrc)
 {
-	/* 1 pixel only */
-	if ((1 == width) && (1 == height)) {
+	(*imx_accel_funcs->upload_sw_16)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
+}
 
-		*(uint32_t*)pBufferDst = *(uint32_t*)pBufferSrc;
-		return;
-	}
-	/* How many bytes to copy per row of rectangle? */
-	int rowCopyBytes = width << 2;
+void
+imx_upload_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->upload_sw_32)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
+}
 
-	/* Width matches pitch for src/dst, then copy entire block */
-	if ((pitchDst == rowCopyBytes) && (pitchSrc == rowCopyBytes)) {
+void
+imx_download_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->download_sw_8)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
+}
 
-		neon_memcpy(pBufferDst, pBufferSrc, rowCopyBytes * height);
+void
+imx_download_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->download_sw_16)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
+}
 
-	/* 1 pixel per row */
-	} else if (1 == width) {
+void
+imx_download_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->download_sw_32)(pBufferDst, pBufferSrc, width, height,
+			pitchDst, pitchSrc);
+}
 
-		while (height-- > 0) {
+void
+imx_convert_sw_rgb565_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert)
+{
+	(*imx_accel_funcs->convert_sw_rgb565_to_y8)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc, invert);
+}
 
-			*(uint32_t*)pBufferDst = *(uint32_t*)pBufferSrc;
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
+void
+imx_convert_sw_xrgb8888_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert)
+{
+	(*imx_accel_funcs->convert_sw_xrgb8888_to_y8)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc, invert);
+}
 
-	/* Use neon_memcpy when width big enough */
-	} else if (32 <= width) {
+void
+imx_dither_sw_ordered_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int x,
+	int y,
+	int levels)
+{
+	(*imx_accel_funcs->dither_sw_ordered_8)(pBufferDst, pBufferSrc, width,
+			height, pitchDst, pitchSrc, x, y, levels);
+}
 
-		while (height-- > 0) {
+void
+imx_dither_sw_diffuse_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int levels)
+{
+	(*imx_accel_funcs->dither_sw_diffuse_8)(pBufferDst, pBufferSrc, width,
+			height, pitchDst, pitchSrc, levels);
+}
 
-			neon_memcpy(pBufferDst, pBufferSrc, rowCopyBytes);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
+void
+imx_composite_sw_over_n_8_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color)
+{
+	(*imx_accel_funcs->composite_sw_over_n_8_0565)(pBufferDst,
+			pBufferMask, width, height, pitchDst, pitchMask,
+			color);
+}
 
-	/* Fallback to use memcpy. */
-	} else {
+void
+imx_composite_sw_over_8888_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->composite_sw_over_8888_0565)(pBufferDst,
+			pBufferSrc, width, height, pitchDst, pitchSrc);
+}
 
-		while (height-- > 0) {
+void
+imx_composite_sw_add_8_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	(*imx_accel_funcs->composite_sw_add_8_8)(pBufferDst, pBufferSrc,
+			width, height, pitchDst, pitchSrc);
+}
 
-			memcpy(pBufferDst, pBufferSrc, rowCopyBytes);
-			pBufferDst += pitchDst;
-			pBufferSrc += pitchSrc;
-		}
-	}
+void
+imx_coverage_sw_add_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	uint32_t coverage)
+{
+	(*imx_accel_funcs->coverage_sw_add_8)(pBufferDst, width, coverage);
 }
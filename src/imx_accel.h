@@ -25,6 +25,8 @@
 #ifndef __IMX_ACCEL_H__
 #define __IMX_ACCEL_H__
 
+#include <stdint.h>
+
 typedef void (*imx_copy_sw_no_overlap_func)(
 	unsigned char* __restrict__ pBufferDst,
 	unsigned char* __restrict__ pBufferSrc,
@@ -33,6 +35,138 @@ typedef void (*imx_copy_sw_no_overlap_func)(
 	int pitchDst,
 	int pitchSrc);
 
+typedef void (*imx_copy_sw_overlap_func)(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+typedef void (*imx_fill_sw_func)(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color);
+
+typedef void (*imx_fill_pattern_sw_func)(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY);
+
+typedef void (*imx_composite_sw_mask_func)(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color);
+
+typedef void (*imx_coverage_sw_func)(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	uint32_t coverage);
+
+typedef void (*imx_convert_sw_func)(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert);
+
+typedef void (*imx_dither_sw_ordered_func)(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int x,
+	int y,
+	int levels);
+
+typedef void (*imx_dither_sw_diffuse_func)(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int levels);
+
+/* -------------------------------------------------------------------- */
+/* Every kernel is built for several instruction sets, each build */
+/* exporting one of these tables.  imx_accel_init picks the best table */
+/* the CPU can run and the functions below call through it. */
+
+typedef struct {
+
+	/* Name of the instruction set, for the log */
+	const char*			name;
+
+	/* Measure the copy thresholds; returns the row length in bytes */
+	/* from which the block copy routine is used */
+	int				(*copy_calibrate)(void);
+
+	imx_copy_sw_no_overlap_func	copy_sw_no_overlap_8;
+	imx_copy_sw_no_overlap_func	copy_sw_no_overlap_16;
+	imx_copy_sw_no_overlap_func	copy_sw_no_overlap_32;
+	imx_copy_sw_overlap_func	copy_sw_overlap_8;
+	imx_copy_sw_overlap_func	copy_sw_overlap_16;
+	imx_copy_sw_overlap_func	copy_sw_overlap_32;
+
+	imx_fill_sw_func		fill_sw_8;
+	imx_fill_sw_func		fill_sw_16;
+	imx_fill_sw_func		fill_sw_32;
+	imx_fill_pattern_sw_func	fill_pattern_sw_8;
+	imx_fill_pattern_sw_func	fill_pattern_sw_16;
+	imx_fill_pattern_sw_func	fill_pattern_sw_32;
+
+	imx_copy_sw_no_overlap_func	upload_sw_8;
+	imx_copy_sw_no_overlap_func	upload_sw_16;
+	imx_copy_sw_no_overlap_func	upload_sw_32;
+	imx_copy_sw_no_overlap_func	download_sw_8;
+	imx_copy_sw_no_overlap_func	download_sw_16;
+	imx_copy_sw_no_overlap_func	download_sw_32;
+
+	imx_convert_sw_func		convert_sw_rgb565_to_y8;
+	imx_convert_sw_func		convert_sw_xrgb8888_to_y8;
+	imx_dither_sw_ordered_func	dither_sw_ordered_8;
+	imx_dither_sw_diffuse_func	dither_sw_diffuse_8;
+
+	imx_composite_sw_mask_func	composite_sw_over_n_8_0565;
+	imx_copy_sw_no_overlap_func	composite_sw_over_8888_0565;
+	imx_copy_sw_no_overlap_func	composite_sw_add_8_8;
+
+	imx_coverage_sw_func		coverage_sw_add_8;
+
+} ImxAccelFuncsRec, *ImxAccelFuncsPtr;
+
+/* Portable C, ARM without NEON (with IMX_ACCEL_ARM only) and NEON */
+extern const ImxAccelFuncsRec imx_accel_funcs_c;
+extern const ImxAccelFuncsRec imx_accel_funcs_arm;
+extern const ImxAccelFuncsRec imx_accel_funcs_neon;
+
+/* Select the kernels from the CPU capabilities; called once at module */
+/* load.  Until then the portable C kernels are used. */
+void imx_accel_init(void);
+
+/* Name of the kernels in use */
+const char* imx_accel_name(void);
+
+/* Calibrated row length from which copies use the block copy routine */
+int imx_accel_copy_threshold(void);
+
+#ifndef IMX_ACCEL_KERNELS
+
 void imx_copy_sw_no_overlap_8(
 	unsigned char* __restrict__ pBufferDst,
 	unsigned char* __restrict__ pBufferSrc,
@@ -57,4 +191,211 @@ void imx_copy_sw_no_overlap_32(
 	int pitchDst,
 	int pitchSrc);
 
+/* Copy a rectangle whose source and destination may overlap. */
+void imx_copy_sw_overlap_8(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_copy_sw_overlap_16(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_copy_sw_overlap_32(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+/* Fill a rectangle with a pixel value of 8, 16 or 32 bits. */
+void imx_fill_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color);
+
+void imx_fill_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color);
+
+void imx_fill_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color);
+
+/* Tile an 8x8 pattern of packed pixels over a rectangle, starting with */
+/* pattern pixel (patternX, patternY) at the top left corner. */
+void imx_fill_pattern_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY);
+
+void imx_fill_pattern_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY);
+
+void imx_fill_pattern_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY);
+
+/* Copy a rectangle into write-combined frame buffer memory, or out of */
+/* it, reading and writing it in aligned bursts. */
+void imx_upload_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_upload_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_upload_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_download_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_download_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_download_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+/* Convert RGB565 / XRGB8888 pixels to 8-bit luma, inverted if invert */
+/* is set (for Y8INV panels where 0 is white). */
+void imx_convert_sw_rgb565_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert);
+
+void imx_convert_sw_xrgb8888_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert);
+
+/* Quantize 8-bit gray to 16 or 2 evenly spaced levels, spreading the */
+/* quantization error with an 8x8 ordered (Bayer) matrix aligned to */
+/* screen position (x, y), or by Floyd-Steinberg error diffusion. */
+void imx_dither_sw_ordered_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int x,
+	int y,
+	int levels);
+
+void imx_dither_sw_diffuse_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int levels);
+
+/* Render composite fast paths on premultiplied pixels.  A solid */
+/* a8r8g8b8 color through an a8 mask OVER r5g6b5, a8r8g8b8 OVER */
+/* r5g6b5, and a8 ADD a8.  The last two have the signature of */
+/* imx_copy_sw_no_overlap_func. */
+void imx_composite_sw_over_n_8_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color);
+
+void imx_composite_sw_over_8888_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_composite_sw_add_8_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+/* Add the same coverage to a row of a8 pixels, saturating, for the */
+/* spans of rasterized shapes */
+void imx_coverage_sw_add_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	uint32_t coverage);
+
+#endif /* IMX_ACCEL_KERNELS */
+
 #endif
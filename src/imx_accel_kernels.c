@@ -0,0 +1,1483 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * CPU kernels.
+ *
+ * This file is built once for each instruction set the driver supports
+ * and imx_accel.c picks one of the builds at load time.  Built on its
+ * own it gives the portable C kernels.  imx_accel_arm.c and
+ * imx_accel_neon.c include it again, with preload hints and with NEON
+ * (__ARM_NEON__ from the compiler flags) respectively.  The kernels are
+ * static; each build only exports its IMX_ACCEL_FUNCS table.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Keep the dispatching prototypes out, the kernels here are static */
+#define	IMX_ACCEL_KERNELS
+#include "imx_accel.h"
+
+#ifndef IMX_ACCEL_FUNCS
+#define	IMX_ACCEL_FUNCS		imx_accel_funcs_c
+#define	IMX_ACCEL_FUNCS_NAME	"C"
+#endif
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+extern void* neon_memcpy(void* dest, const void* source, unsigned int numBytes);
+extern void* neon_memmove(void* dest, const void* source, unsigned int numBytes);
+
+#define	IMX_MEMCPY	neon_memcpy
+#define	IMX_MEMMOVE	neon_memmove
+#else
+#define	IMX_MEMCPY	memcpy
+#define	IMX_MEMMOVE	memmove
+#endif
+
+/* Start loading the next source row while this one is processed */
+#if defined(IMX_ACCEL_PRELOAD)
+#define	IMX_PRELOAD(p)	__builtin_prefetch(p)
+#else
+#define	IMX_PRELOAD(p)
+#endif
+
+/*
+ * Copies without overlap.
+ *
+ * Rather than one loop with size checks for every row, the kernels are
+ * generated by the macros below for each row size class and alignment,
+ * and imx_copy_sw_no_overlap_{8,16,32} pick one per call:
+ *
+ *   block  contiguous source and destination rows, one copy
+ *   fixed  rows of up to IMX_COPY_FIXED_MAX_BYTES (glyphs, cursors),
+ *          copied with a constant size that compiles to plain loads and
+ *          stores, word sized ones when everything is word aligned
+ *   word   word aligned rows below the block copy threshold
+ *   row    other rows below the threshold, through memcpy
+ *   wide   rows from the threshold up, through IMX_MEMCPY
+ *
+ * The threshold is where IMX_MEMCPY starts to beat memcpy, measured by
+ * imx_copy_calibrate when the kernels are selected.
+ */
+
+/* Longest rows with a fixed size kernel */
+#define	IMX_COPY_FIXED_MAX_BYTES	32
+
+/* Block copy threshold until imx_copy_calibrate has run */
+#define	IMX_COPY_BLOCK_BYTES_DEFAULT	128
+
+/* Rows at least this long are copied with IMX_MEMCPY / IMX_MEMMOVE */
+static int imx_copy_block_bytes = IMX_COPY_BLOCK_BYTES_DEFAULT;
+
+typedef void (*imx_copy_rows_func)(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int rowCopyBytes,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+/* Kernel copying each row of a rectangle with copyRow */
+#define	IMX_COPY_ROWS_KERNEL(name, copyRow)				\
+static void								\
+name(									\
+	unsigned char* __restrict__ pBufferDst,				\
+	unsigned char* __restrict__ pBufferSrc,				\
+	int rowCopyBytes,						\
+	int height,							\
+	int pitchDst,							\
+	int pitchSrc)							\
+{									\
+	while (height-- > 0) {						\
+									\
+		IMX_PRELOAD(pBufferSrc + pitchSrc);			\
+		copyRow;						\
+		pBufferDst += pitchDst;					\
+		pBufferSrc += pitchSrc;					\
+	}								\
+}
+
+/* Rows of a size known at compile time, at any alignment */
+#define	IMX_COPY_FIXED_KERNEL(bytes)					\
+	IMX_COPY_ROWS_KERNEL(imx_copy_fixed_##bytes,			\
+		memcpy(pBufferDst, pBufferSrc, bytes))
+
+/* Rows of a size known at compile time, word aligned */
+#define	IMX_COPY_FIXED_ALIGNED_KERNEL(bytes)				\
+	IMX_COPY_ROWS_KERNEL(imx_copy_fixed_aligned_##bytes,		\
+		memcpy(__builtin_assume_aligned(pBufferDst, 4),		\
+			__builtin_assume_aligned(pBufferSrc, 4), bytes))
+
+/* Rows of whole words */
+static inline void
+imx_copy_row_words(
+	uint32_t* __restrict__ pDst,
+	const uint32_t* __restrict__ pSrc,
+	int words)
+{
+	while (words-- > 0) {
+		*pDst++ = *pSrc++;
+	}
+}
+
+IMX_COPY_ROWS_KERNEL(imx_copy_rows_word,
+	imx_copy_row_words((uint32_t*)pBufferDst, (const uint32_t*)pBufferSrc,
+				rowCopyBytes >> 2))
+
+IMX_COPY_ROWS_KERNEL(imx_copy_rows_small,
+	memcpy(pBufferDst, pBufferSrc, rowCopyBytes))
+
+IMX_COPY_ROWS_KERNEL(imx_copy_rows_wide,
+	IMX_MEMCPY(pBufferDst, pBufferSrc, rowCopyBytes))
+
+IMX_COPY_FIXED_KERNEL(1)
+IMX_COPY_FIXED_KERNEL(2)
+IMX_COPY_FIXED_KERNEL(3)
+IMX_COPY_FIXED_KERNEL(4)
+IMX_COPY_FIXED_KERNEL(5)
+IMX_COPY_FIXED_KERNEL(6)
+IMX_COPY_FIXED_KERNEL(7)
+IMX_COPY_FIXED_KERNEL(8)
+IMX_COPY_FIXED_KERNEL(9)
+IMX_COPY_FIXED_KERNEL(10)
+IMX_COPY_FIXED_KERNEL(11)
+IMX_COPY_FIXED_KERNEL(12)
+IMX_COPY_FIXED_KERNEL(13)
+IMX_COPY_FIXED_KERNEL(14)
+IMX_COPY_FIXED_KERNEL(15)
+IMX_COPY_FIXED_KERNEL(16)
+IMX_COPY_FIXED_KERNEL(17)
+IMX_COPY_FIXED_KERNEL(18)
+IMX_COPY_FIXED_KERNEL(19)
+IMX_COPY_FIXED_KERNEL(20)
+IMX_COPY_FIXED_KERNEL(21)
+IMX_COPY_FIXED_KERNEL(22)
+IMX_COPY_FIXED_KERNEL(23)
+IMX_COPY_FIXED_KERNEL(24)
+IMX_COPY_FIXED_KERNEL(25)
+IMX_COPY_FIXED_KERNEL(26)
+IMX_COPY_FIXED_KERNEL(27)
+IMX_COPY_FIXED_KERNEL(28)
+IMX_COPY_FIXED_KERNEL(29)
+IMX_COPY_FIXED_KERNEL(30)
+IMX_COPY_FIXED_KERNEL(31)
+IMX_COPY_FIXED_KERNEL(32)
+
+IMX_COPY_FIXED_ALIGNED_KERNEL(4)
+IMX_COPY_FIXED_ALIGNED_KERNEL(8)
+IMX_COPY_FIXED_ALIGNED_KERNEL(12)
+IMX_COPY_FIXED_ALIGNED_KERNEL(16)
+IMX_COPY_FIXED_ALIGNED_KERNEL(20)
+IMX_COPY_FIXED_ALIGNED_KERNEL(24)
+IMX_COPY_FIXED_ALIGNED_KERNEL(28)
+IMX_COPY_FIXED_ALIGNED_KERNEL(32)
+
+/* Fixed size kernels for each pixel size, indexed by width */
+static const imx_copy_rows_func imx_copy_fixed_width_8[] = {
+	NULL, imx_copy_fixed_1, imx_copy_fixed_2, imx_copy_fixed_3,
+	imx_copy_fixed_4, imx_copy_fixed_5, imx_copy_fixed_6,
+	imx_copy_fixed_7, imx_copy_fixed_8, imx_copy_fixed_9,
+	imx_copy_fixed_10, imx_copy_fixed_11, imx_copy_fixed_12,
+	imx_copy_fixed_13, imx_copy_fixed_14, imx_copy_fixed_15,
+	imx_copy_fixed_16, imx_copy_fixed_17, imx_copy_fixed_18,
+	imx_copy_fixed_19, imx_copy_fixed_20, imx_copy_fixed_21,
+	imx_copy_fixed_22, imx_copy_fixed_23, imx_copy_fixed_24,
+	imx_copy_fixed_25, imx_copy_fixed_26, imx_copy_fixed_27,
+	imx_copy_fixed_28, imx_copy_fixed_29, imx_copy_fixed_30,
+	imx_copy_fixed_31, imx_copy_fixed_32
+};
+
+static const imx_copy_rows_func imx_copy_fixed_width_16[] = {
+	NULL, imx_copy_fixed_2, imx_copy_fixed_4, imx_copy_fixed_6,
+	imx_copy_fixed_8, imx_copy_fixed_10, imx_copy_fixed_12,
+	imx_copy_fixed_14, imx_copy_fixed_16, imx_copy_fixed_18,
+	imx_copy_fixed_20, imx_copy_fixed_22, imx_copy_fixed_24,
+	imx_copy_fixed_26, imx_copy_fixed_28, imx_copy_fixed_30,
+	imx_copy_fixed_32
+};
+
+static const imx_copy_rows_func imx_copy_fixed_width_32[] = {
+	NULL, imx_copy_fixed_4, imx_copy_fixed_8, imx_copy_fixed_12,
+	imx_copy_fixed_16, imx_copy_fixed_20, imx_copy_fixed_24,
+	imx_copy_fixed_28, imx_copy_fixed_32
+};
+
+/* Word aligned fixed size kernels, indexed by words per row */
+static const imx_copy_rows_func imx_copy_fixed_aligned[] = {
+	NULL,
+	imx_copy_fixed_aligned_4, imx_copy_fixed_aligned_8,
+	imx_copy_fixed_aligned_12, imx_copy_fixed_aligned_16,
+	imx_copy_fixed_aligned_20, imx_copy_fixed_aligned_24,
+	imx_copy_fixed_aligned_28, imx_copy_fixed_aligned_32
+};
+
+/* Copy dispatcher for a pixel size of 1 << shift bytes */
+#define	IMX_COPY_NO_OVERLAP_KERNEL(bitsPerPixel, shift)			\
+static void								\
+imx_copy_sw_no_overlap_##bitsPerPixel(					\
+	unsigned char* __restrict__ pBufferDst,				\
+	unsigned char* __restrict__ pBufferSrc,				\
+	int width,							\
+	int height,							\
+	int pitchDst,							\
+	int pitchSrc)							\
+{									\
+	const int rowCopyBytes = width << (shift);			\
+									\
+	if ((width <= 0) || (height <= 0)) {				\
+		return;							\
+	}								\
+									\
+	/* Contiguous rows, copy entire block */			\
+	if ((1 == height) ||						\
+		((pitchDst == rowCopyBytes) &&				\
+			(pitchSrc == rowCopyBytes))) {			\
+									\
+		const int bytes = rowCopyBytes * height;		\
+		if (bytes >= imx_copy_block_bytes) {			\
+			IMX_MEMCPY(pBufferDst, pBufferSrc, bytes);	\
+		} else {						\
+			memcpy(pBufferDst, pBufferSrc, bytes);		\
+		}							\
+		return;							\
+	}								\
+									\
+	const int aligned = (0 == (((uintptr_t)pBufferDst |		\
+		(uintptr_t)pBufferSrc | pitchDst | pitchSrc |		\
+		rowCopyBytes) & 3));					\
+	imx_copy_rows_func copyRows;					\
+									\
+	if (rowCopyBytes <= IMX_COPY_FIXED_MAX_BYTES) {			\
+		copyRows = aligned ?					\
+			imx_copy_fixed_aligned[rowCopyBytes >> 2] :	\
+			imx_copy_fixed_width_##bitsPerPixel[width];		\
+	} else if (rowCopyBytes >= imx_copy_block_bytes) {		\
+		copyRows = imx_copy_rows_wide;				\
+	} else if (aligned) {						\
+		copyRows = imx_copy_rows_word;				\
+	} else {							\
+		copyRows = imx_copy_rows_small;				\
+	}								\
+									\
+	(*copyRows)(pBufferDst, pBufferSrc, rowCopyBytes, height,	\
+			pitchDst, pitchSrc);				\
+}
+
+IMX_COPY_NO_OVERLAP_KERNEL(8, 0)
+IMX_COPY_NO_OVERLAP_KERNEL(16, 1)
+IMX_COPY_NO_OVERLAP_KERNEL(32, 2)
+
+#if defined(__ARM_NEON__)
+/* Time in nanoseconds to copy height rows of rowCopyBytes */
+static long
+imx_copy_calibrate_time(
+	imx_copy_rows_func copyRows,
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int rowCopyBytes,
+	int height,
+	int pitch)
+{
+	struct timespec start, end;
+	long best = -1;
+	int run;
+
+	/* Best of a few runs, the first also warms the caches */
+	for (run = 0; run < 4; ++run) {
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		(*copyRows)(pBufferDst, pBufferSrc, rowCopyBytes, height,
+				pitch, pitch);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		const long ns = (end.tv_sec - start.tv_sec) * 1000000000L +
+				(end.tv_nsec - start.tv_nsec);
+		if ((best < 0) || (ns < best)) {
+			best = ns;
+		}
+	}
+
+	return best;
+}
+#endif
+
+/* Calibration row sizes and the rows copied for each */
+#define	IMX_COPY_CALIBRATE_MIN_BYTES	32
+#define	IMX_COPY_CALIBRATE_MAX_BYTES	2048
+#define	IMX_COPY_CALIBRATE_ROWS		32
+
+/*
+ * Find the shortest row from which IMX_MEMCPY is faster than memcpy for
+ * every longer row too, and use it as the block copy threshold.  Copies
+ * between odd row offsets so neither routine gets aligned rows for free.
+ * Takes a few milliseconds; without a separate IMX_MEMCPY there is
+ * nothing to measure.
+ */
+static int
+imx_copy_calibrate(void)
+{
+#if defined(__ARM_NEON__)
+	const int pitch = IMX_COPY_CALIBRATE_MAX_BYTES + 64;
+	unsigned char* pBuffer = malloc(2 * pitch * IMX_COPY_CALIBRATE_ROWS);
+	int rowCopyBytes;
+
+	if (NULL == pBuffer) {
+		return imx_copy_block_bytes;
+	}
+	memset(pBuffer, 0, 2 * pitch * IMX_COPY_CALIBRATE_ROWS);
+
+	unsigned char* pBufferSrc = pBuffer + 3;
+	unsigned char* pBufferDst = pBuffer + pitch * IMX_COPY_CALIBRATE_ROWS + 7;
+	int threshold = IMX_COPY_CALIBRATE_MAX_BYTES;
+
+	/* Longest rows first, stopping where memcpy starts to win */
+	for (rowCopyBytes = IMX_COPY_CALIBRATE_MAX_BYTES;
+		rowCopyBytes >= IMX_COPY_CALIBRATE_MIN_BYTES;
+		rowCopyBytes >>= 1) {
+
+		const long timeSmall = imx_copy_calibrate_time(
+			imx_copy_rows_small, pBufferDst, pBufferSrc,
+			rowCopyBytes, IMX_COPY_CALIBRATE_ROWS, pitch);
+		const long timeWide = imx_copy_calibrate_time(
+			imx_copy_rows_wide, pBufferDst, pBufferSrc,
+			rowCopyBytes, IMX_COPY_CALIBRATE_ROWS, pitch);
+
+		if (timeWide > timeSmall) {
+			break;
+		}
+		threshold = rowCopyBytes;
+	}
+
+	free(pBuffer);
+	imx_copy_block_bytes = threshold;
+#endif
+
+	return imx_copy_block_bytes;
+}
+
+/*
+ * Copy a rectangle whose source and destination may overlap, as when
+ * scrolling within a pixmap.  Rows are copied bottom up when the
+ * destination follows the source in memory, so no source row is written
+ * before it is read.  Only a sideways move makes a row overlap itself.
+ */
+static void
+imx_copy_sw_overlap(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int rowCopyBytes,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	if (pBufferDst > pBufferSrc) {
+
+		pBufferDst += (height - 1) * pitchDst;
+		pBufferSrc += (height - 1) * pitchSrc;
+		pitchDst = -pitchDst;
+		pitchSrc = -pitchSrc;
+	}
+
+	while (height-- > 0) {
+
+		const int overlap =
+			(pBufferDst < pBufferSrc + rowCopyBytes) &&
+			(pBufferSrc < pBufferDst + rowCopyBytes);
+
+		if (!overlap) {
+
+			memcpy(pBufferDst, pBufferSrc, rowCopyBytes);
+
+		} else if (imx_copy_block_bytes <= rowCopyBytes) {
+
+			IMX_MEMMOVE(pBufferDst, pBufferSrc, rowCopyBytes);
+
+		} else {
+
+			memmove(pBufferDst, pBufferSrc, rowCopyBytes);
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+static void
+imx_copy_sw_overlap_8(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	imx_copy_sw_overlap(pBufferDst, pBufferSrc, width, height,
+				pitchDst, pitchSrc);
+}
+
+static void
+imx_copy_sw_overlap_16(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	imx_copy_sw_overlap(pBufferDst, pBufferSrc, width << 1, height,
+				pitchDst, pitchSrc);
+}
+
+static void
+imx_copy_sw_overlap_32(
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	imx_copy_sw_overlap(pBufferDst, pBufferSrc, width << 2, height,
+				pitchDst, pitchSrc);
+}
+
+/*
+ * Store one pixel of the replicated fill pattern.  The pattern repeats
+ * every 4 bytes, so any pixel aligned address holds the same bytes.
+ */
+#define IMX_FILL_STORE_PIXEL(pDst, pattern, bytesPerPixel)	\
+	switch (bytesPerPixel) {				\
+	case 1: *(uint8_t*)(pDst) = (uint8_t)(pattern); break;	\
+	case 2: *(uint16_t*)(pDst) = (uint16_t)(pattern); break;	\
+	default: *(uint32_t*)(pDst) = (pattern); break;		\
+	}
+
+/*
+ * Fill a run of bytes with a 32-bit pattern holding the color replicated
+ * for the pixel size.  Pixels are stored one at a time up to a quad-word
+ * boundary so the bulk of the run uses aligned 128-bit stores.
+ */
+static void
+imx_fill_row(
+	unsigned char* pBufferDst,
+	int bytes,
+	uint32_t pattern,
+	int bytesPerPixel)
+{
+	/* Single pixels up to the quad-word boundary */
+	while ((bytes > 0) && (0 != ((uintptr_t)pBufferDst & 15))) {
+
+		IMX_FILL_STORE_PIXEL(pBufferDst, pattern, bytesPerPixel);
+		pBufferDst += bytesPerPixel;
+		bytes -= bytesPerPixel;
+	}
+
+#if defined(__ARM_NEON__)
+	const uint8x16_t vPattern = vreinterpretq_u8_u32(vdupq_n_u32(pattern));
+
+	/* Four quad-words per iteration */
+	while (bytes >= 64) {
+
+		uint8_t* pDst = __builtin_assume_aligned(pBufferDst, 16);
+		vst1q_u8(pDst, vPattern);
+		vst1q_u8(pDst + 16, vPattern);
+		vst1q_u8(pDst + 32, vPattern);
+		vst1q_u8(pDst + 48, vPattern);
+		pBufferDst += 64;
+		bytes -= 64;
+	}
+
+	while (bytes >= 16) {
+
+		vst1q_u8(__builtin_assume_aligned(pBufferDst, 16), vPattern);
+		pBufferDst += 16;
+		bytes -= 16;
+	}
+#else
+	while (bytes >= 16) {
+
+		uint32_t* pDst = __builtin_assume_aligned(pBufferDst, 16);
+		pDst[0] = pattern;
+		pDst[1] = pattern;
+		pDst[2] = pattern;
+		pDst[3] = pattern;
+		pBufferDst += 16;
+		bytes -= 16;
+	}
+#endif
+
+	/* Remaining pixels past the last quad-word */
+	while (bytes > 0) {
+
+		IMX_FILL_STORE_PIXEL(pBufferDst, pattern, bytesPerPixel);
+		pBufferDst += bytesPerPixel;
+		bytes -= bytesPerPixel;
+	}
+}
+
+static void
+imx_fill_sw(
+	unsigned char* pBufferDst,
+	int rowFillBytes,
+	int height,
+	int pitchDst,
+	uint32_t pattern,
+	int bytesPerPixel)
+{
+	/* Width matches pitch, then fill entire block */
+	if (pitchDst == rowFillBytes) {
+
+		imx_fill_row(pBufferDst, rowFillBytes * height, pattern,
+				bytesPerPixel);
+		return;
+	}
+
+	while (height-- > 0) {
+
+		imx_fill_row(pBufferDst, rowFillBytes, pattern, bytesPerPixel);
+		pBufferDst += pitchDst;
+	}
+}
+
+static void
+imx_fill_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	imx_fill_sw(pBufferDst, width, height, pitchDst,
+			(color & 0xFF) * 0x01010101, 1);
+}
+
+static void
+imx_fill_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	imx_fill_sw(pBufferDst, width << 1, height, pitchDst,
+			(color & 0xFFFF) * 0x00010001, 2);
+}
+
+static void
+imx_fill_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	imx_fill_sw(pBufferDst, width << 2, height, pitchDst, color, 4);
+}
+
+/* Bytes in one expanded row of the 8x8 fill pattern */
+#define IMX_FILL_PATTERN_LINE_BYTES	64
+
+/*
+ * Tile an 8x8 pattern over a rectangle.  The pattern is 8 rows of 8
+ * pixels packed without padding.  patternX and patternY give the pattern
+ * pixel drawn at the top left corner of the rectangle.  Each pattern row
+ * is expanded into a 64 byte line starting at the right phase, which is
+ * then repeated across the destination row.
+ */
+static void
+imx_fill_pattern_sw(
+	unsigned char* pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY,
+	int bytesPerPixel)
+{
+	uint8_t line[IMX_FILL_PATTERN_LINE_BYTES] __attribute__((aligned(16)));
+	const int patternPitch = bytesPerPixel * 8;
+	const int rowFillBytes = width * bytesPerPixel;
+	int y;
+
+	patternX &= 7;
+
+	for (y = 0; y < height; ++y) {
+
+		const unsigned char* pPatternRow =
+			pPattern + ((patternY + y) & 7) * patternPitch;
+		unsigned char* pDst = pBufferDst;
+		int bytes = rowFillBytes;
+		int i;
+
+		/* Expand the pattern row starting at the phase of the first pixel */
+		for (i = 0; i < IMX_FILL_PATTERN_LINE_BYTES; i += patternPitch) {
+
+			const int headBytes = patternX * bytesPerPixel;
+			memcpy(line + i, pPatternRow + headBytes,
+				patternPitch - headBytes);
+			memcpy(line + i + patternPitch - headBytes, pPatternRow,
+				headBytes);
+		}
+
+#if defined(__ARM_NEON__)
+		const uint8x16_t v0 = vld1q_u8(line);
+		const uint8x16_t v1 = vld1q_u8(line + 16);
+		const uint8x16_t v2 = vld1q_u8(line + 32);
+		const uint8x16_t v3 = vld1q_u8(line + 48);
+
+		while (bytes >= IMX_FILL_PATTERN_LINE_BYTES) {
+
+			vst1q_u8(pDst, v0);
+			vst1q_u8(pDst + 16, v1);
+			vst1q_u8(pDst + 32, v2);
+			vst1q_u8(pDst + 48, v3);
+			pDst += IMX_FILL_PATTERN_LINE_BYTES;
+			bytes -= IMX_FILL_PATTERN_LINE_BYTES;
+		}
+#else
+		while (bytes >= IMX_FILL_PATTERN_LINE_BYTES) {
+
+			memcpy(pDst, line, IMX_FILL_PATTERN_LINE_BYTES);
+			pDst += IMX_FILL_PATTERN_LINE_BYTES;
+			bytes -= IMX_FILL_PATTERN_LINE_BYTES;
+		}
+#endif
+
+		memcpy(pDst, line, bytes);
+		pBufferDst += pitchDst;
+	}
+}
+
+static void
+imx_fill_pattern_sw_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	imx_fill_pattern_sw(pBufferDst, width, height, pitchDst,
+				pPattern, patternX, patternY, 1);
+}
+
+static void
+imx_fill_pattern_sw_16(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	imx_fill_pattern_sw(pBufferDst, width, height, pitchDst,
+				pPattern, patternX, patternY, 2);
+}
+
+static void
+imx_fill_pattern_sw_32(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	const unsigned char* pPattern,
+	int patternX,
+	int patternY)
+{
+	imx_fill_pattern_sw(pBufferDst, width, height, pitchDst,
+				pPattern, patternX, patternY, 4);
+}
+
+/*
+ * Image transfers between system memory and frame buffer memory.
+ *
+ * The frame buffer is mapped write-combined: writes are gathered into
+ * bursts as long as they arrive in address order and cover whole lines,
+ * and reads go all the way to DRAM without the help of the cache.
+ * Uploads therefore write each row front to back in aligned quad-words,
+ * never reading the destination, and downloads read the frame buffer in
+ * aligned quad-words so each read is a full bus transfer.  The side in
+ * system memory is preloaded ahead of the copy.
+ */
+
+/* How far ahead of the copy the system memory side is preloaded */
+#define	IMX_TRANSFER_PRELOAD_BYTES	256
+
+/* Copy one row to a write-combined destination */
+static inline void
+imx_upload_row(
+	unsigned char* __restrict__ pDst,
+	const unsigned char* __restrict__ pSrc,
+	int bytes)
+{
+	/* Bytes up to the first quad-word boundary of the destination */
+	const int headBytes = (16 - ((uintptr_t)pDst & 15)) & 15;
+	if (headBytes >= bytes) {
+
+		memcpy(pDst, pSrc, bytes);
+		return;
+	}
+	memcpy(pDst, pSrc, headBytes);
+	pDst += headBytes;
+	pSrc += headBytes;
+	bytes -= headBytes;
+
+#if defined(__ARM_NEON__)
+	/* Four quad-words per iteration, stored in address order */
+	while (bytes >= 64) {
+
+		IMX_PRELOAD(pSrc + IMX_TRANSFER_PRELOAD_BYTES);
+
+		const uint8x16_t v0 = vld1q_u8(pSrc);
+		const uint8x16_t v1 = vld1q_u8(pSrc + 16);
+		const uint8x16_t v2 = vld1q_u8(pSrc + 32);
+		const uint8x16_t v3 = vld1q_u8(pSrc + 48);
+
+		uint8_t* pDstAligned = __builtin_assume_aligned(pDst, 16);
+		vst1q_u8(pDstAligned, v0);
+		vst1q_u8(pDstAligned + 16, v1);
+		vst1q_u8(pDstAligned + 32, v2);
+		vst1q_u8(pDstAligned + 48, v3);
+
+		pDst += 64;
+		pSrc += 64;
+		bytes -= 64;
+	}
+#endif
+
+	while (bytes >= 16) {
+
+		IMX_PRELOAD(pSrc + IMX_TRANSFER_PRELOAD_BYTES);
+
+		uint32_t words[4];
+		memcpy(words, pSrc, 16);
+
+		uint32_t* pDstAligned = __builtin_assume_aligned(pDst, 16);
+		pDstAligned[0] = words[0];
+		pDstAligned[1] = words[1];
+		pDstAligned[2] = words[2];
+		pDstAligned[3] = words[3];
+
+		pDst += 16;
+		pSrc += 16;
+		bytes -= 16;
+	}
+
+	memcpy(pDst, pSrc, bytes);
+}
+
+/* Copy one row from an uncached source */
+static inline void
+imx_download_row(
+	unsigned char* __restrict__ pDst,
+	const unsigned char* __restrict__ pSrc,
+	int bytes)
+{
+	/* Bytes up to the first quad-word boundary of the source */
+	const int headBytes = (16 - ((uintptr_t)pSrc & 15)) & 15;
+	if (headBytes >= bytes) {
+
+		memcpy(pDst, pSrc, bytes);
+		return;
+	}
+	memcpy(pDst, pSrc, headBytes);
+	pDst += headBytes;
+	pSrc += headBytes;
+	bytes -= headBytes;
+
+#if defined(__ARM_NEON__)
+	/* Four quad-word reads in flight per iteration */
+	while (bytes >= 64) {
+
+		IMX_PRELOAD(pDst + IMX_TRANSFER_PRELOAD_BYTES);
+
+		const uint8_t* pSrcAligned = __builtin_assume_aligned(pSrc, 16);
+		const uint8x16_t v0 = vld1q_u8(pSrcAligned);
+		const uint8x16_t v1 = vld1q_u8(pSrcAligned + 16);
+		const uint8x16_t v2 = vld1q_u8(pSrcAligned + 32);
+		const uint8x16_t v3 = vld1q_u8(pSrcAligned + 48);
+
+		vst1q_u8(pDst, v0);
+		vst1q_u8(pDst + 16, v1);
+		vst1q_u8(pDst + 32, v2);
+		vst1q_u8(pDst + 48, v3);
+
+		pDst += 64;
+		pSrc += 64;
+		bytes -= 64;
+	}
+#endif
+
+	while (bytes >= 16) {
+
+		const uint32_t* pSrcAligned = __builtin_assume_aligned(pSrc, 16);
+		uint32_t words[4];
+		words[0] = pSrcAligned[0];
+		words[1] = pSrcAligned[1];
+		words[2] = pSrcAligned[2];
+		words[3] = pSrcAligned[3];
+		memcpy(pDst, words, 16);
+
+		pDst += 16;
+		pSrc += 16;
+		bytes -= 16;
+	}
+
+	memcpy(pDst, pSrc, bytes);
+}
+
+/* Upload and download kernel for a pixel size of 1 << shift bytes */
+#define	IMX_TRANSFER_KERNEL(name, copyRow, shift)			\
+static void								\
+name(									\
+	unsigned char* __restrict__ pBufferDst,				\
+	unsigned char* __restrict__ pBufferSrc,				\
+	int width,							\
+	int height,							\
+	int pitchDst,							\
+	int pitchSrc)							\
+{									\
+	const int rowCopyBytes = width << (shift);			\
+									\
+	while (height-- > 0) {						\
+									\
+		copyRow(pBufferDst, pBufferSrc, rowCopyBytes);		\
+		pBufferDst += pitchDst;					\
+		pBufferSrc += pitchSrc;					\
+	}								\
+}
+
+IMX_TRANSFER_KERNEL(imx_upload_sw_8, imx_upload_row, 0)
+IMX_TRANSFER_KERNEL(imx_upload_sw_16, imx_upload_row, 1)
+IMX_TRANSFER_KERNEL(imx_upload_sw_32, imx_upload_row, 2)
+IMX_TRANSFER_KERNEL(imx_download_sw_8, imx_download_row, 0)
+IMX_TRANSFER_KERNEL(imx_download_sw_16, imx_download_row, 1)
+IMX_TRANSFER_KERNEL(imx_download_sw_32, imx_download_row, 2)
+
+/* Luma weights sum to 256 so white stays 0xFF */
+#define IMX_LUMA_R	77
+#define IMX_LUMA_G	150
+#define IMX_LUMA_B	29
+
+static void
+imx_convert_sw_rgb565_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert)
+{
+	const uint8_t mask = invert ? 0xFF : 0x00;
+
+#if defined(__ARM_NEON__)
+	const uint8x8_t vMask = vdup_n_u8(mask);
+	const uint16x8_t vGreenMask = vdupq_n_u16(0x3F);
+	const uint16x8_t vBlueMask = vdupq_n_u16(0x1F);
+#endif
+
+	while (height-- > 0) {
+
+		IMX_PRELOAD(pBufferSrc + pitchSrc);
+
+		const uint16_t* pSrc = (const uint16_t*)pBufferSrc;
+		uint8_t* pDst = pBufferDst;
+		int x = 0;
+
+#if defined(__ARM_NEON__)
+		/* 8 pixels at a time */
+		for (; x + 8 <= width; x += 8) {
+
+			const uint16x8_t pixels = vld1q_u16(pSrc + x);
+
+			/* Expand each channel to 8 bits */
+			uint16x8_t r = vshrq_n_u16(pixels, 11);
+			uint16x8_t g = vandq_u16(vshrq_n_u16(pixels, 5), vGreenMask);
+			uint16x8_t b = vandq_u16(pixels, vBlueMask);
+			r = vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2));
+			g = vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4));
+			b = vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2));
+
+			uint16x8_t y = vmulq_n_u16(r, IMX_LUMA_R);
+			y = vmlaq_n_u16(y, g, IMX_LUMA_G);
+			y = vmlaq_n_u16(y, b, IMX_LUMA_B);
+
+			vst1_u8(pDst + x, veor_u8(vshrn_n_u16(y, 8), vMask));
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; x < width; ++x) {
+
+			const uint16_t pixel = pSrc[x];
+			const int r = (pixel >> 11) & 0x1F;
+			const int g = (pixel >> 5) & 0x3F;
+			const int b = pixel & 0x1F;
+
+			const int y =
+				((r << 3) | (r >> 2)) * IMX_LUMA_R +
+				((g << 2) | (g >> 4)) * IMX_LUMA_G +
+				((b << 3) | (b >> 2)) * IMX_LUMA_B;
+
+			pDst[x] = (uint8_t)(y >> 8) ^ mask;
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+static void
+imx_convert_sw_xrgb8888_to_y8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int invert)
+{
+	const uint8_t mask = invert ? 0xFF : 0x00;
+
+#if defined(__ARM_NEON__)
+	const uint8x8_t vMask = vdup_n_u8(mask);
+	const uint8x8_t vLumaR = vdup_n_u8(IMX_LUMA_R);
+	const uint8x8_t vLumaG = vdup_n_u8(IMX_LUMA_G);
+	const uint8x8_t vLumaB = vdup_n_u8(IMX_LUMA_B);
+#endif
+
+	while (height-- > 0) {
+
+		IMX_PRELOAD(pBufferSrc + pitchSrc);
+
+		const uint32_t* pSrc = (const uint32_t*)pBufferSrc;
+		uint8_t* pDst = pBufferDst;
+		int x = 0;
+
+#if defined(__ARM_NEON__)
+		/* 8 pixels at a time, deinterleaved into B, G, R, X */
+		for (; x + 8 <= width; x += 8) {
+
+			const uint8x8x4_t pixels =
+				vld4_u8((const uint8_t*)(pSrc + x));
+
+			uint16x8_t y = vmull_u8(pixels.val[2], vLumaR);
+			y = vmlal_u8(y, pixels.val[1], vLumaG);
+			y = vmlal_u8(y, pixels.val[0], vLumaB);
+
+			vst1_u8(pDst + x, veor_u8(vshrn_n_u16(y, 8), vMask));
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; x < width; ++x) {
+
+			const uint32_t pixel = pSrc[x];
+			const int y =
+				((pixel >> 16) & 0xFF) * IMX_LUMA_R +
+				((pixel >> 8) & 0xFF) * IMX_LUMA_G +
+				(pixel & 0xFF) * IMX_LUMA_B;
+
+			pDst[x] = (uint8_t)(y >> 8) ^ mask;
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+/* 8x8 Bayer matrix, thresholds 0 to 63 */
+static const uint8_t imx_dither_bayer_8x8[8][8] = {
+	{  0, 32,  8, 40,  2, 34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44,  4, 36, 14, 46,  6, 38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{  3, 35, 11, 43,  1, 33,  9, 41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47,  7, 39, 13, 45,  5, 37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+/* Nearest of the 16 levels 0, 17, ... 255 (241 / 4096 ~ 1 / 17), or */
+/* black or white for 2 levels.  Input must be clamped to 0..255. */
+#define IMX_DITHER_QUANTIZE(value, levels) \
+	((16 == (levels)) ? \
+		(((value) * 241 + 2048) >> 12) * 17 : \
+		(((value) >= 128) ? 255 : 0))
+
+#define IMX_DITHER_CLAMP(value) \
+	(((value) < 0) ? 0 : (((value) > 255) ? 255 : (value)))
+
+static void
+imx_dither_sw_ordered_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int x,
+	int y,
+	int levels)
+{
+	const int step = (16 == levels) ? 17 : 255;
+
+	/* Offsets centered on 0 and within half a step, so pixels that */
+	/* already are at one of the levels stay there. Each row is */
+	/* stored twice so 8 offsets can be read from any phase. */
+	int16_t offsets[8][16];
+	int i, j;
+	for (i = 0; i < 8; ++i) {
+		for (j = 0; j < 16; ++j) {
+			const int threshold = imx_dither_bayer_8x8[i][j & 7];
+			offsets[i][j] = ((2 * threshold + 1 - 64) * step) / 128;
+		}
+	}
+
+	const int phaseX = x & 7;
+	int row = y & 7;
+
+	while (height-- > 0) {
+
+		const int16_t* pOffsets = &offsets[row][phaseX];
+		int col = 0;
+
+#if defined(__ARM_NEON__)
+		const int16x8_t vOffsets = vld1q_s16(pOffsets);
+		const int16x8_t vZero = vdupq_n_s16(0);
+		const int16x8_t vMax = vdupq_n_s16(255);
+
+		/* 8 pixels at a time; the matrix repeats every 8 */
+		for (; col + 8 <= width; col += 8) {
+
+			int16x8_t value = vreinterpretq_s16_u16(
+				vmovl_u8(vld1_u8(pBufferSrc + col)));
+			value = vaddq_s16(value, vOffsets);
+			value = vminq_s16(vmaxq_s16(value, vZero), vMax);
+
+			const uint16x8_t v = vreinterpretq_u16_s16(value);
+			uint8x8_t out;
+			if (16 == levels) {
+				uint16x8_t q = vmulq_n_u16(v, 241);
+				q = vshrq_n_u16(vaddq_u16(q, vdupq_n_u16(2048)), 12);
+				out = vmovn_u16(vmulq_n_u16(q, 17));
+			} else {
+				out = vmovn_u16(vcgeq_u16(v, vdupq_n_u16(128)));
+			}
+
+			vst1_u8(pBufferDst + col, out);
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; col < width; ++col) {
+
+			int value = pBufferSrc[col] + pOffsets[col & 7];
+			value = IMX_DITHER_CLAMP(value);
+			pBufferDst[col] = IMX_DITHER_QUANTIZE(value, levels);
+		}
+
+		row = (row + 1) & 7;
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+static void
+imx_dither_sw_diffuse_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc,
+	int levels)
+{
+	/* Error carried into the current row, and quantization error */
+	/* of each pixel of the current row.  One entry of padding at */
+	/* both ends avoids testing for the edges. */
+	int16_t* pRowError = calloc(2 * (width + 2), sizeof(int16_t));
+	if (NULL == pRowError) {
+
+		/* Ordered dithering is better than none at all */
+		imx_dither_sw_ordered_8(pBufferDst, pBufferSrc, width, height,
+					pitchDst, pitchSrc, 0, 0, levels);
+		return;
+	}
+	int16_t* pPixelError = pRowError + width + 2;
+
+	while (height-- > 0) {
+
+		/* Left to right, passing 7/16 of the error to the right. */
+		/* This part is inherently serial. */
+		int carry = 0;
+		int col;
+		for (col = 0; col < width; ++col) {
+
+			int value = pBufferSrc[col] + pRowError[col + 1] + carry;
+			value = IMX_DITHER_CLAMP(value);
+
+			const int out = IMX_DITHER_QUANTIZE(value, levels);
+			const int error = value - out;
+
+			pBufferDst[col] = out;
+			pPixelError[col + 1] = error;
+			carry = (error * 7) >> 4;
+		}
+
+		/* The error for the next row, 3/16 from the right, 5/16 */
+		/* from above and 1/16 from the left, has no dependencies */
+		/* between pixels. */
+		col = 0;
+
+#if defined(__ARM_NEON__)
+		for (; col + 8 <= width; col += 8) {
+
+			const int16x8_t left = vld1q_s16(pPixelError + col);
+			const int16x8_t above = vld1q_s16(pPixelError + col + 1);
+			const int16x8_t right = vld1q_s16(pPixelError + col + 2);
+
+			int16x8_t sum = vmulq_n_s16(right, 3);
+			sum = vmlaq_n_s16(sum, above, 5);
+			sum = vaddq_s16(sum, left);
+
+			vst1q_s16(pRowError + col + 1, vshrq_n_s16(sum, 4));
+		}
+#endif
+
+		for (; col < width; ++col) {
+
+			const int sum =
+				pPixelError[col + 2] * 3 +
+				pPixelError[col + 1] * 5 +
+				pPixelError[col];
+
+			pRowError[col + 1] = sum >> 4;
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+
+	free(pRowError);
+}
+
+/* x * a / 255 rounded, exact for 8-bit x and a */
+#define IMX_MUL_UN8(x, a) \
+	({ const unsigned int t_ = (x) * (a) + 0x80; (t_ + (t_ >> 8)) >> 8; })
+
+#define IMX_ADD_UN8(x, y) \
+	({ const unsigned int s_ = (x) + (y); (s_ > 0xFF) ? 0xFF : s_; })
+
+/* Premultiplied source channels over one r5g6b5 pixel */
+static inline uint16_t
+imx_composite_over_0565(
+	uint16_t pixel,
+	unsigned int r,
+	unsigned int g,
+	unsigned int b,
+	unsigned int a)
+{
+	unsigned int dr = (pixel >> 11) & 0x1F;
+	unsigned int dg = (pixel >> 5) & 0x3F;
+	unsigned int db = pixel & 0x1F;
+
+	dr = (dr << 3) | (dr >> 2);
+	dg = (dg << 2) | (dg >> 4);
+	db = (db << 3) | (db >> 2);
+
+	dr = IMX_ADD_UN8(r, IMX_MUL_UN8(dr, 0xFF - a));
+	dg = IMX_ADD_UN8(g, IMX_MUL_UN8(dg, 0xFF - a));
+	db = IMX_ADD_UN8(b, IMX_MUL_UN8(db, 0xFF - a));
+
+	return ((dr & 0xF8) << 8) | ((dg & 0xFC) << 3) | (db >> 3);
+}
+
+#if defined(__ARM_NEON__)
+/* x * a / 255 rounded for 8 channels, same result as IMX_MUL_UN8 */
+static inline uint8x8_t
+imx_neon_mul_un8(uint8x8_t x, uint8x8_t a)
+{
+	const uint16x8_t t = vmull_u8(x, a);
+	return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+/* Premultiplied source channels over 8 r5g6b5 pixels */
+static inline uint16x8_t
+imx_neon_over_0565(
+	uint16x8_t pixels,
+	uint8x8_t r,
+	uint8x8_t g,
+	uint8x8_t b,
+	uint8x8_t a)
+{
+	/* Expand each channel to 8 bits */
+	uint8x8_t dr = vshrn_n_u16(pixels, 8);
+	uint8x8_t dg = vshrn_n_u16(pixels, 3);
+	uint8x8_t db = vshrn_n_u16(vshlq_n_u16(pixels, 5), 2);
+	dr = vsri_n_u8(dr, dr, 5);
+	dg = vsri_n_u8(dg, dg, 6);
+	db = vsri_n_u8(db, db, 5);
+
+	const uint8x8_t ia = vmvn_u8(a);
+	dr = vqadd_u8(r, imx_neon_mul_un8(dr, ia));
+	dg = vqadd_u8(g, imx_neon_mul_un8(dg, ia));
+	db = vqadd_u8(b, imx_neon_mul_un8(db, ia));
+
+	/* Pack back to r5g6b5 */
+	uint16x8_t result = vshll_n_u8(dr, 8);
+	result = vsriq_n_u16(result, vshll_n_u8(dg, 8), 5);
+	return vsriq_n_u16(result, vshll_n_u8(db, 8), 11);
+}
+#endif
+
+static void
+imx_composite_sw_over_n_8_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color)
+{
+	const unsigned int sa = (color >> 24) & 0xFF;
+	const unsigned int sr = (color >> 16) & 0xFF;
+	const unsigned int sg = (color >> 8) & 0xFF;
+	const unsigned int sb = color & 0xFF;
+
+#if defined(__ARM_NEON__)
+	const uint8x8_t vSa = vdup_n_u8(sa);
+	const uint8x8_t vSr = vdup_n_u8(sr);
+	const uint8x8_t vSg = vdup_n_u8(sg);
+	const uint8x8_t vSb = vdup_n_u8(sb);
+#endif
+
+	while (height-- > 0) {
+
+		uint16_t* pDst = (uint16_t*)pBufferDst;
+		const uint8_t* pMask = pBufferMask;
+		int x = 0;
+
+#if defined(__ARM_NEON__)
+		/* 8 pixels at a time */
+		for (; x + 8 <= width; x += 8) {
+
+			const uint8x8_t m = vld1_u8(pMask + x);
+
+			/* Nothing to do where the mask is clear, as in glyph gaps */
+			if (0 == vget_lane_u64(vreinterpret_u64_u8(m), 0)) {
+				continue;
+			}
+
+			vst1q_u16(pDst + x,
+				imx_neon_over_0565(
+					vld1q_u16(pDst + x),
+					imx_neon_mul_un8(vSr, m),
+					imx_neon_mul_un8(vSg, m),
+					imx_neon_mul_un8(vSb, m),
+					imx_neon_mul_un8(vSa, m)));
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; x < width; ++x) {
+
+			const unsigned int m = pMask[x];
+			if (0 == m) {
+				continue;
+			}
+
+			pDst[x] = imx_composite_over_0565(pDst[x],
+					IMX_MUL_UN8(sr, m),
+					IMX_MUL_UN8(sg, m),
+					IMX_MUL_UN8(sb, m),
+					IMX_MUL_UN8(sa, m));
+		}
+
+		pBufferDst += pitchDst;
+		pBufferMask += pitchMask;
+	}
+}
+
+static void
+imx_composite_sw_over_8888_0565(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	while (height-- > 0) {
+
+		uint16_t* pDst = (uint16_t*)pBufferDst;
+		const uint32_t* pSrc = (const uint32_t*)pBufferSrc;
+		int x = 0;
+
+#if defined(__ARM_NEON__)
+		/* 8 pixels at a time, deinterleaved into B, G, R, A */
+		for (; x + 8 <= width; x += 8) {
+
+			const uint8x8x4_t s = vld4_u8((const uint8_t*)(pSrc + x));
+
+			vst1q_u16(pDst + x,
+				imx_neon_over_0565(vld1q_u16(pDst + x),
+					s.val[2], s.val[1], s.val[0], s.val[3]));
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; x < width; ++x) {
+
+			const uint32_t s = pSrc[x];
+
+			/* Transparent source leaves the pixel as it is */
+			if (0 == s) {
+				continue;
+			}
+
+			pDst[x] = imx_composite_over_0565(pDst[x],
+					(s >> 16) & 0xFF, (s >> 8) & 0xFF, s & 0xFF,
+					s >> 24);
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+static void
+imx_composite_sw_add_8_8(
+	unsigned char* __restrict__ pBufferDst,
+	unsigned char* __restrict__ pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	while (height-- > 0) {
+
+		uint8_t* pDst = pBufferDst;
+		const uint8_t* pSrc = pBufferSrc;
+		int x = 0;
+
+#if defined(__ARM_NEON__)
+		/* 16 pixels at a time */
+		for (; x + 16 <= width; x += 16) {
+
+			vst1q_u8(pDst + x,
+				vqaddq_u8(vld1q_u8(pDst + x), vld1q_u8(pSrc + x)));
+		}
+#endif
+
+		/* Remaining pixels */
+		for (; x < width; ++x) {
+
+			pDst[x] = IMX_ADD_UN8(pDst[x], pSrc[x]);
+		}
+
+		pBufferDst += pitchDst;
+		pBufferSrc += pitchSrc;
+	}
+}
+
+/* -------------------------------------------------------------------- */
+
+static void
+imx_coverage_sw_add_8(
+	unsigned char* __restrict__ pBufferDst,
+	int width,
+	uint32_t coverage)
+{
+	uint8_t* pDst = pBufferDst;
+	int x = 0;
+
+#if defined(__ARM_NEON__)
+	const uint8x16_t vCoverage = vdupq_n_u8(coverage);
+
+	/* 16 pixels at a time */
+	for (; x + 16 <= width; x += 16) {
+
+		vst1q_u8(pDst + x, vqaddq_u8(vld1q_u8(pDst + x), vCoverage));
+	}
+#endif
+
+	/* Remaining pixels */
+	for (; x < width; ++x) {
+
+		pDst[x] = IMX_ADD_UN8(pDst[x], coverage);
+	}
+}
+
+const ImxAccelFuncsRec IMX_ACCEL_FUNCS = {
+
+	.name = IMX_ACCEL_FUNCS_NAME,
+	.copy_calibrate = imx_copy_calibrate,
+
+	.copy_sw_no_overlap_8 = imx_copy_sw_no_overlap_8,
+	.copy_sw_no_overlap_16 = imx_copy_sw_no_overlap_16,
+	.copy_sw_no_overlap_32 = imx_copy_sw_no_overlap_32,
+	.copy_sw_overlap_8 = imx_copy_sw_overlap_8,
+	.copy_sw_overlap_16 = imx_copy_sw_overlap_16,
+	.copy_sw_overlap_32 = imx_copy_sw_overlap_32,
+
+	.fill_sw_8 = imx_fill_sw_8,
+	.fill_sw_16 = imx_fill_sw_16,
+	.fill_sw_32 = imx_fill_sw_32,
+	.fill_pattern_sw_8 = imx_fill_pattern_sw_8,
+	.fill_pattern_sw_16 = imx_fill_pattern_sw_16,
+	.fill_pattern_sw_32 = imx_fill_pattern_sw_32,
+
+	.upload_sw_8 = imx_upload_sw_8,
+	.upload_sw_16 = imx_upload_sw_16,
+	.upload_sw_32 = imx_upload_sw_32,
+	.download_sw_8 = imx_download_sw_8,
+	.download_sw_16 = imx_download_sw_16,
+	.download_sw_32 = imx_download_sw_32,
+
+	.convert_sw_rgb565_to_y8 = imx_convert_sw_rgb565_to_y8,
+	.convert_sw_xrgb8888_to_y8 = imx_convert_sw_xrgb8888_to_y8,
+	.dither_sw_ordered_8 = imx_dither_sw_ordered_8,
+	.dither_sw_diffuse_8 = imx_dither_sw_diffuse_8,
+
+	.composite_sw_over_n_8_0565 = imx_composite_sw_over_n_8_0565,
+	.composite_sw_over_8888_0565 = imx_composite_sw_over_8888_0565,
+	.composite_sw_add_8_8 = imx_composite_sw_add_8_8,
+
+	.coverage_sw_add_8 = imx_coverage_sw_add_8
+};
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * CPU kernels for ARM cores with NEON.  This file is built with the NEON
+ * compiler flags, which enable the __ARM_NEON__ paths of the kernels and
+ * the neon_memcpy / neon_memmove routines.
+ */
+
+#if !defined(__ARM_NEON__)
+#error "imx_accel_neon.c must be built with NEON enabled"
+#endif
+
+#define	IMX_ACCEL_FUNCS		imx_accel_funcs_neon
+#define	IMX_ACCEL_FUNCS_NAME	"NEON"
+#define	IMX_ACCEL_PRELOAD	1
+
+#include "imx_accel_kernels.c"
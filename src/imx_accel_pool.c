@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * Worker pool for the CPU kernels.
+ *
+ * The X server renders on one thread while the i.MX5/6 parts have more
+ * cores sitting idle.  Large fills, copies and composites are cut into
+ * horizontal bands which the workers and the calling thread take from a
+ * shared counter.  The calling thread waits for the last band, so to the
+ * caller an operation still completes before it returns.
+ *
+ * Starting a band on another core costs a wakeup, so operations below
+ * IMX_ACCEL_POOL_MIN_PIXELS are not worth splitting and run inline.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "imx_accel_pool.h"
+
+/* Kind of kernel a job runs */
+enum {
+	IMX_ACCEL_JOB_FILL,
+	IMX_ACCEL_JOB_COPY,
+	IMX_ACCEL_JOB_COMPOSITE_MASK
+};
+
+/* One rectangle operation and its kernel */
+typedef struct {
+
+	int				kind;
+	union {
+		imx_fill_sw_func		fill;
+		imx_copy_sw_no_overlap_func	copy;
+		imx_composite_sw_mask_func	compositeMask;
+	} func;
+
+	unsigned char*			pBufferDst;
+	unsigned char*			pBufferSrc;	/* source or mask */
+	int				width;
+	int				height;
+	int				pitchDst;
+	int				pitchSrc;
+	uint32_t			color;
+
+} ImxAccelJobRec, *ImxAccelJobPtr;
+
+struct _ImxAccelPool {
+
+	int				numThreads;
+	pthread_t			threads[IMX_ACCEL_POOL_MAX_THREADS];
+
+	/* Everything below is protected by mutex */
+	pthread_mutex_t			mutex;
+	pthread_cond_t			condWork;
+	pthread_cond_t			condDone;
+	int				exit;
+
+	/* Bumped for each job so sleeping workers know to look */
+	unsigned			generation;
+
+	/* Current job and its bands */
+	ImxAccelJobPtr			pJob;
+	int				numBands;
+	int				nextBand;
+	int				bandsDone;
+};
+
+/* -------------------------------------------------------------------- */
+
+/* Run rows y1 up to y2 of a job */
+static void
+imx_accel_job_run_band(ImxAccelJobPtr pJob, int y1, int y2)
+{
+	unsigned char* pBufferDst = pJob->pBufferDst + y1 * pJob->pitchDst;
+	unsigned char* pBufferSrc = pJob->pBufferSrc + y1 * pJob->pitchSrc;
+
+	switch (pJob->kind) {
+
+	case IMX_ACCEL_JOB_FILL:
+		(*pJob->func.fill)(pBufferDst, pJob->width, y2 - y1,
+					pJob->pitchDst, pJob->color);
+		break;
+
+	case IMX_ACCEL_JOB_COPY:
+		(*pJob->func.copy)(pBufferDst, pBufferSrc, pJob->width, y2 - y1,
+					pJob->pitchDst, pJob->pitchSrc);
+		break;
+
+	case IMX_ACCEL_JOB_COMPOSITE_MASK:
+		(*pJob->func.compositeMask)(pBufferDst, pBufferSrc,
+					pJob->width, y2 - y1,
+					pJob->pitchDst, pJob->pitchSrc,
+					pJob->color);
+		break;
+	}
+}
+
+/* Take and run bands of the current job until none are left. */
+/* Called and returns with the mutex held. */
+static void
+imx_accel_pool_run_bands(ImxAccelPoolPtr pPool)
+{
+	while (pPool->nextBand < pPool->numBands) {
+
+		ImxAccelJobPtr pJob = pPool->pJob;
+		const int band = pPool->nextBand++;
+		const int y1 = pJob->height * band / pPool->numBands;
+		const int y2 = pJob->height * (band + 1) / pPool->numBands;
+
+		pthread_mutex_unlock(&pPool->mutex);
+		imx_accel_job_run_band(pJob, y1, y2);
+		pthread_mutex_lock(&pPool->mutex);
+
+		if (++pPool->bandsDone == pPool->numBands) {
+			pthread_cond_signal(&pPool->condDone);
+		}
+	}
+}
+
+static void*
+imx_accel_pool_thread(void* arg)
+{
+	ImxAccelPoolPtr pPool = arg;
+
+	pthread_mutex_lock(&pPool->mutex);
+
+	unsigned generation = pPool->generation;
+	while (!pPool->exit) {
+
+		if (generation == pPool->generation) {
+
+			pthread_cond_wait(&pPool->condWork, &pPool->mutex);
+			continue;
+		}
+		generation = pPool->generation;
+
+		imx_accel_pool_run_bands(pPool);
+	}
+
+	pthread_mutex_unlock(&pPool->mutex);
+	return NULL;
+}
+
+static void
+imx_accel_pool_run(ImxAccelPoolPtr pPool, ImxAccelJobPtr pJob)
+{
+	/* Small operations are not worth waking anybody up for */
+	int numBands = pJob->height / IMX_ACCEL_POOL_MIN_BAND_ROWS;
+	if ((NULL == pPool) ||
+		(pJob->width * pJob->height < IMX_ACCEL_POOL_MIN_PIXELS) ||
+		(numBands < 2)) {
+
+		imx_accel_job_run_band(pJob, 0, pJob->height);
+		return;
+	}
+
+	/* One band for each worker and one for this thread */
+	if (numBands > pPool->numThreads + 1) {
+		numBands = pPool->numThreads + 1;
+	}
+
+	pthread_mutex_lock(&pPool->mutex);
+
+	pPool->pJob = pJob;
+	pPool->numBands = numBands;
+	pPool->nextBand = 0;
+	pPool->bandsDone = 0;
+	++pPool->generation;
+	pthread_cond_broadcast(&pPool->condWork);
+
+	/* Help out, then wait for the bands still running elsewhere */
+	imx_accel_pool_run_bands(pPool);
+	while (pPool->bandsDone < pPool->numBands) {
+		pthread_cond_wait(&pPool->condDone, &pPool->mutex);
+	}
+
+	pPool->pJob = NULL;
+
+	pthread_mutex_unlock(&pPool->mutex);
+}
+
+/* -------------------------------------------------------------------- */
+
+ImxAccelPoolPtr
+imx_accel_pool_create(int numThreads)
+{
+	/* Default to one worker per additional core */
+	if (numThreads < 0) {
+		numThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	}
+	if (numThreads > IMX_ACCEL_POOL_MAX_THREADS) {
+		numThreads = IMX_ACCEL_POOL_MAX_THREADS;
+	}
+	if (numThreads <= 0) {
+		return NULL;
+	}
+
+	ImxAccelPoolPtr pPool = calloc(sizeof(ImxAccelPoolRec), 1);
+	if (NULL == pPool) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&pPool->mutex, NULL);
+	pthread_cond_init(&pPool->condWork, NULL);
+	pthread_cond_init(&pPool->condDone, NULL);
+
+	/* Signals are for the server thread; workers inherit this mask */
+	sigset_t sigAll, sigSaved;
+	sigfillset(&sigAll);
+	pthread_sigmask(SIG_BLOCK, &sigAll, &sigSaved);
+
+	while (pPool->numThreads < numThreads) {
+
+		if (0 != pthread_create(&pPool->threads[pPool->numThreads],
+					NULL, imx_accel_pool_thread, pPool)) {
+			break;
+		}
+		++pPool->numThreads;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &sigSaved, NULL);
+
+	if (0 == pPool->numThreads) {
+
+		imx_accel_pool_destroy(pPool);
+		return NULL;
+	}
+
+	return pPool;
+}
+
+void
+imx_accel_pool_destroy(ImxAccelPoolPtr pPool)
+{
+	int i;
+
+	if (NULL == pPool) {
+		return;
+	}
+
+	pthread_mutex_lock(&pPool->mutex);
+	pPool->exit = 1;
+	pthread_cond_broadcast(&pPool->condWork);
+	pthread_mutex_unlock(&pPool->mutex);
+
+	for (i = 0; i < pPool->numThreads; ++i) {
+		pthread_join(pPool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pPool->condDone);
+	pthread_cond_destroy(&pPool->condWork);
+	pthread_mutex_destroy(&pPool->mutex);
+	free(pPool);
+}
+
+int
+imx_accel_pool_threads(ImxAccelPoolPtr pPool)
+{
+	return (NULL != pPool) ? pPool->numThreads : 0;
+}
+
+void
+imx_accel_pool_fill(
+	ImxAccelPoolPtr pPool,
+	imx_fill_sw_func fillFunc,
+	unsigned char* pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color)
+{
+	ImxAccelJobRec job = {
+		.kind = IMX_ACCEL_JOB_FILL,
+		.func.fill = fillFunc,
+		.pBufferDst = pBufferDst,
+		.pBufferSrc = NULL,
+		.width = width,
+		.height = height,
+		.pitchDst = pitchDst,
+		.pitchSrc = 0,
+		.color = color
+	};
+
+	imx_accel_pool_run(pPool, &job);
+}
+
+void
+imx_accel_pool_copy(
+	ImxAccelPoolPtr pPool,
+	imx_copy_sw_no_overlap_func copyFunc,
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc)
+{
+	ImxAccelJobRec job = {
+		.kind = IMX_ACCEL_JOB_COPY,
+		.func.copy = copyFunc,
+		.pBufferDst = pBufferDst,
+		.pBufferSrc = pBufferSrc,
+		.width = width,
+		.height = height,
+		.pitchDst = pitchDst,
+		.pitchSrc = pitchSrc,
+		.color = 0
+	};
+
+	imx_accel_pool_run(pPool, &job);
+}
+
+void
+imx_accel_pool_composite_mask(
+	ImxAccelPoolPtr pPool,
+	imx_composite_sw_mask_func compositeFunc,
+	unsigned char* pBufferDst,
+	unsigned char* pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color)
+{
+	ImxAccelJobRec job = {
+		.kind = IMX_ACCEL_JOB_COMPOSITE_MASK,
+		.func.compositeMask = compositeFunc,
+		.pBufferDst = pBufferDst,
+		.pBufferSrc = pBufferMask,
+		.width = width,
+		.height = height,
+		.pitchDst = pitchDst,
+		.pitchSrc = pitchMask,
+		.color = color
+	};
+
+	imx_accel_pool_run(pPool, &job);
+}
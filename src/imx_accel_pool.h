@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+#ifndef __IMX_ACCEL_POOL_H__
+#define __IMX_ACCEL_POOL_H__
+
+#include "imx_accel.h"
+
+/* Operations smaller than this many pixels run on the calling thread */
+#define	IMX_ACCEL_POOL_MIN_PIXELS	(64 * 1024)
+
+/* Fewest rows handed to one thread */
+#define	IMX_ACCEL_POOL_MIN_BAND_ROWS	16
+
+/* Most worker threads in a pool */
+#define	IMX_ACCEL_POOL_MAX_THREADS	8
+
+typedef struct _ImxAccelPool ImxAccelPoolRec, *ImxAccelPoolPtr;
+
+/* Start numThreads worker threads, or one per additional online CPU */
+/* when numThreads is negative.  Returns NULL if no thread could be */
+/* started, in which case every operation simply runs inline. */
+ImxAccelPoolPtr imx_accel_pool_create(int numThreads);
+
+void imx_accel_pool_destroy(ImxAccelPoolPtr pPool);
+
+int imx_accel_pool_threads(ImxAccelPoolPtr pPool);
+
+/* Same as calling the kernels directly, but large rectangles are */
+/* split into bands of rows that run on the worker threads and the */
+/* calling thread together.  All return once the whole rectangle is */
+/* done.  pPool may be NULL.  Source and destination must not */
+/* overlap, since the bands run in no particular order. */
+void imx_accel_pool_fill(
+	ImxAccelPoolPtr pPool,
+	imx_fill_sw_func fillFunc,
+	unsigned char* pBufferDst,
+	int width,
+	int height,
+	int pitchDst,
+	uint32_t color);
+
+void imx_accel_pool_copy(
+	ImxAccelPoolPtr pPool,
+	imx_copy_sw_no_overlap_func copyFunc,
+	unsigned char* pBufferDst,
+	unsigned char* pBufferSrc,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchSrc);
+
+void imx_accel_pool_composite_mask(
+	ImxAccelPoolPtr pPool,
+	imx_composite_sw_mask_func compositeFunc,
+	unsigned char* pBufferDst,
+	unsigned char* pBufferMask,
+	int width,
+	int height,
+	int pitchDst,
+	int pitchMask,
+	uint32_t color);
+
+#endif
@@ -35,12 +35,14 @@
 #include "xf86.h"
 #include "xf86Priv.h"
 #include "xf86Crtc.h"
+#include "xf86RandR12.h"
 #include "xf86DDC.h"
 #include "fbdevhw.h"
 #include "xorgVersion.h"
 
 #include "imx.h"
 #include "imx_display.h"
+#include "imx_epdc.h"
 
 #include "compat-api.h"
 
@@ -97,6 +99,10 @@ typedef struct {
 	/* Flag set if XRandR shadow buffer allocated */
 	Bool		fbShadowAllocated;
 
+	/* EPDC frame buffer rotation (FB_ROTATE_*) the server started */
+	/* with; XRandR rotations are relative to it. */
+	int		fbBaseRotate;
+
 	/* Buffer for reading EDID monitor data */
 	Uchar		edidDataBytes[128];
 
@@ -426,6 +432,11 @@ imxDisplaySetMode(ScrnInfoPtr pScrn, const char* fbDeviceName,
 			modeName, strerror(errno));
 		return FALSE;
 	}
+
+	/* The EPDC shadow is converted using the new line length */
+	if (0 != imxPtr->epdcShadowBpp) {
+		imxPtr->epdcFbPitch = fbFixScreenInfo.line_length;
+	}
 		
 	/* If the shadow memory is allocated, then we have some */
 	/* adjustments to do. */
@@ -911,6 +922,37 @@ imxCrtcModeSet(xf86CrtcPtr crtc, DisplayModePtr mode, DisplayModePtr adjMode,
 
 		imxDisplaySetMode(pScrn, imxPtr->fbDeviceName, fbMode->name);
 	}
+
+	/* The EPDC rotates the frame buffer itself.  XRandR rotations */
+	/* are counter-clockwise, FB_ROTATE_CW is a clockwise one. */
+	if (imxPtr->isEPDC) {
+
+		/* Access display private screen data */
+		ImxDisplayPtr fPtr = IMXDISPLAYPTR(imxPtr);
+
+		int fbRotate;
+		switch (crtc->rotation & 0xf) {
+
+		case RR_Rotate_90:
+			fbRotate = FB_ROTATE_CCW;
+			break;
+
+		case RR_Rotate_180:
+			fbRotate = FB_ROTATE_UD;
+			break;
+
+		case RR_Rotate_270:
+			fbRotate = FB_ROTATE_CW;
+			break;
+
+		default:
+			fbRotate = FB_ROTATE_UR;
+			break;
+		}
+
+		imxDisplayChangeFrameBufferRotateEPDC(pScrn->scrnIndex,
+			(fPtr->fbBaseRotate + fbRotate) % 4);
+	}
 }
 
 static void
@@ -1246,6 +1288,7 @@ imxDisplayPreInit(ScrnInfoPtr pScrn)
 	fPtr->outputPtr = NULL;
 	fPtr->atomEdid = 0;
 	fPtr->fbShadowAllocated = FALSE;
+	fPtr->fbBaseRotate = FB_ROTATE_UR;
 
 	/* Access all the modes supported by frame buffer driver. */
 	fPtr->fbModesList = imxDisplayGetModes(pScrn, imxPtr->fbDeviceName);
@@ -1292,6 +1335,32 @@ imxDisplayPreInit(ScrnInfoPtr pScrn)
 		fPtr->fbMaxHeight = mode->VDisplay;
 	}
 
+	/* The EPDC can rotate the frame buffer by quarter turns, so */
+	/* the screen must fit in either orientation. */
+	if (imxPtr->isEPDC) {
+
+		if (fPtr->fbMinHeight < fPtr->fbMinWidth) {
+			fPtr->fbMinWidth = fPtr->fbMinHeight;
+		} else {
+			fPtr->fbMinHeight = fPtr->fbMinWidth;
+		}
+
+		if (fPtr->fbMaxHeight > fPtr->fbMaxWidth) {
+			fPtr->fbMaxWidth = fPtr->fbMaxHeight;
+		} else {
+			fPtr->fbMaxHeight = fPtr->fbMaxWidth;
+		}
+
+		/* Keep whatever rotation the frame buffer was set up with */
+		struct fb_var_screeninfo fbVarScreenInfo;
+		int fdDev = fbdevHWGetFD(pScrn);
+		if ((-1 != fdDev) &&
+			(-1 != ioctl(fdDev, FBIOGET_VSCREENINFO, &fbVarScreenInfo))) {
+
+			fPtr->fbBaseRotate = fbVarScreenInfo.rotate % 4;
+		}
+	}
+
 	/* Initialize display private data structure. */
 	fPtr->crtcPtr = NULL;
 	fPtr->outputPtr = NULL;
@@ -1332,6 +1401,12 @@ imxDisplayPreInit(ScrnInfoPtr pScrn)
 		return FALSE;
 	}
 
+	/* No shadow pixmap is needed when the EPDC does the rotation */
+	if (imxPtr->isEPDC) {
+
+		fPtr->crtcPtr->driverIsPerformingTransform = TRUE;
+	}
+
 	/* Establish output callbacks. */
 	fPtr->imxOutputFuncs.create_resources = imxOutputCreateResources;
 	fPtr->imxOutputFuncs.dpms = imxOutputDPMS;
@@ -1426,10 +1501,14 @@ imxDisplayStartScreenInit(int scrnIndex, ScreenPtr pScreen)
 				fbVarScreenInfo.bits_per_pixel / 8;
 	}
 
-	pScrn->displayWidth = lineLength / (pScrn->bitsPerPixel / 8);
+	/* Same number of pixels per line whether X renders into the */
+	/* frame buffer or into an EPDC shadow of it */
+	pScrn->displayWidth = lineLength / (fbVarScreenInfo.bits_per_pixel / 8);
 
-	if ((TrueColor == pScrn->defaultVisual) ||
-		(DirectColor == pScrn->defaultVisual)) {
+	/* An EPDC shadow keeps the channel layout from xf86SetWeight */
+	if (((TrueColor == pScrn->defaultVisual) ||
+		(DirectColor == pScrn->defaultVisual)) &&
+		(fbVarScreenInfo.bits_per_pixel == pScrn->bitsPerPixel)) {
 
 		pScrn->offset.red   = fbVarScreenInfo.red.offset;
 		pScrn->offset.green = fbVarScreenInfo.green.offset;
@@ -1449,12 +1528,23 @@ imxDisplayStartScreenInit(int scrnIndex, ScreenPtr pScreen)
 Bool
 imxDisplayFinishScreenInit(int scrnIndex, ScreenPtr pScreen)
 {
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
 	/* Completes the screen initialization for outputs and CRTCs */
 	if (!xf86CrtcScreenInit(pScreen)) {
 		xf86DrvMsg(scrnIndex, X_ERROR, "xf86CrtcScreenInit failed\n");
 		return FALSE;
 	}
 
+	/* The EPDC rotates by quarter turns, but cannot reflect */
+	if (imxPtr->isEPDC) {
+
+		xf86RandR12SetRotations(pScreen,
+			RR_Rotate_0 | RR_Rotate_90 | RR_Rotate_180 | RR_Rotate_270);
+		xf86RandR12SetTransformSupport(pScreen, FALSE);
+	}
+
 	/* All DPMS mode switching will be managed by using the dpms */
 	/* DPMS functions provided by the outputs and CRTCs */
 	xf86DPMSInit(pScreen, xf86DPMSSet, 0);
@@ -1469,7 +1559,19 @@ imxDisplaySwitchMode(SWITCH_MODE_ARGS_DECL)
 {
 	SCRN_INFO_PTR(arg);
 
-	return xf86SetSingleMode(pScrn, mode, RR_Rotate_0);
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access display private screen data */
+	ImxDisplayPtr fPtr = IMXDISPLAYPTR(imxPtr);
+
+	/* Keep the current rotation across mode switches */
+	Rotation rotation = RR_Rotate_0;
+	if (NULL != fPtr->crtcPtr) {
+		rotation = fPtr->crtcPtr->rotation;
+	}
+
+	return xf86SetSingleMode(pScrn, mode, rotation);
 }
 
 void
@@ -1496,3 +1598,118 @@ imxDisplayValidMode(int scrnIndex, DisplayModePtr mode, Bool verbose, int flags)
 {
 	return MODE_OK;
 }
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Rotate the EPDC frame buffer to fbRotate (one of FB_ROTATE_*) relative
+ * to the panel.  The EPDC applies the rotation while it updates the
+ * panel, so X keeps drawing into an unrotated frame buffer whose width
+ * and height trade places with the panel's on quarter turns.
+ */
+Bool
+imxDisplayChangeFrameBufferRotateEPDC(int scrnIndex, int fbRotate)
+{
+	ScrnInfoPtr pScrn = xf86Screens[scrnIndex];
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	if (!imxPtr->isEPDC) {
+		return FALSE;
+	}
+
+	/* Access the fd for the FB driver */
+	int fdDev = fbdevHWGetFD(pScrn);
+	if (-1 == fdDev) {
+		return FALSE;
+	}
+
+	struct fb_var_screeninfo fbVarScreenInfo;
+	if (-1 == ioctl(fdDev, FBIOGET_VSCREENINFO, &fbVarScreenInfo)) {
+
+		xf86DrvMsg(scrnIndex, X_ERROR,
+			"unable to get VSCREENINFO for rotation: %s\n",
+			strerror(errno));
+		return FALSE;
+	}
+
+	if (fbVarScreenInfo.rotate == fbRotate) {
+		return TRUE;
+	}
+
+	/* Updates drawn for the old orientation have to reach the */
+	/* panel before the frame buffer layout changes under them. */
+	ScreenPtr pScreen = pScrn->pScreen;
+	if (NULL != pScreen) {
+		imxEpdcWaitForUpdate(pScreen, imxEpdcFlushUpdates(pScreen));
+	}
+
+	if ((fbVarScreenInfo.rotate ^ fbRotate) & 1) {
+
+		const __u32 xres = fbVarScreenInfo.xres;
+		fbVarScreenInfo.xres = fbVarScreenInfo.yres;
+		fbVarScreenInfo.yres = xres;
+	}
+	fbVarScreenInfo.xres_virtual = fbVarScreenInfo.xres;
+	fbVarScreenInfo.yres_virtual = fbVarScreenInfo.yres;
+	fbVarScreenInfo.xoffset = 0;
+	fbVarScreenInfo.yoffset = 0;
+	fbVarScreenInfo.rotate = fbRotate;
+	fbVarScreenInfo.activate = FB_ACTIVATE_NOW;
+
+	if (-1 == ioctl(fdDev, FBIOPUT_VSCREENINFO, &fbVarScreenInfo)) {
+
+		xf86DrvMsg(scrnIndex, X_ERROR,
+			"unable to rotate frame buffer to %d: %s\n",
+			fbRotate, strerror(errno));
+		return FALSE;
+	}
+
+	/* Rotating changes the line length of the frame buffer */
+	struct fb_fix_screeninfo fbFixScreenInfo;
+	if (-1 == ioctl(fdDev, FBIOGET_FSCREENINFO, &fbFixScreenInfo)) {
+
+		xf86DrvMsg(scrnIndex, X_ERROR,
+			"unable to get FSCREENINFO for rotation: %s\n",
+			strerror(errno));
+		return FALSE;
+	}
+
+	if (0 != imxPtr->epdcShadowBpp) {
+
+		imxPtr->epdcFbPitch = fbFixScreenInfo.line_length;
+
+	} else {
+
+		pScrn->displayWidth = fbFixScreenInfo.line_length /
+					(fbVarScreenInfo.bits_per_pixel / 8);
+
+		/* X draws straight into the frame buffer */
+		PixmapPtr pScreenPixmap = NULL;
+		if (NULL != pScreen) {
+			pScreenPixmap = (*pScreen->GetScreenPixmap)(pScreen);
+		}
+		if (NULL != pScreenPixmap) {
+
+			(*pScreen->ModifyPixmapHeader)(
+				pScreenPixmap,
+				pScrn->virtualX,
+				pScrn->virtualY,
+				-1,		/* same depth */
+				-1,		/* same bitsperpixel */
+				fbFixScreenInfo.line_length,
+				NULL);		/* same memory ptr */
+		}
+	}
+
+	if (NULL != pScreen) {
+		imxEpdcScreenRotated(pScreen);
+	}
+
+	xf86DrvMsg(scrnIndex, X_INFO,
+		"EPDC frame buffer rotated %d degrees clockwise\n",
+		fbRotate * 90);
+
+	return TRUE;
+}
@@ -56,6 +56,8 @@
 
 #include "imx.h"
 #include "imx_display.h"
+#include "imx_epdc.h"
+#include "imx_exa.h"
 
 #if IMX_XVIDEO_ENABLE
 #include "xf86xv.h"
@@ -63,7 +65,6 @@
 
 
 #define IMX_NAME		"imx"
-#define IMX_DRIVER_NAME		"imx"
 
 #define IMX_VERSION_MAJOR	PACKAGE_VERSION_MAJOR
 #define IMX_VERSION_MINOR	PACKAGE_VERSION_MINOR
@@ -97,20 +98,68 @@ static SymTabRec imxChipsets[] = {
 typedef enum {
 	OPTION_FBDEV,
 	OPTION_FORMAT_EPDC,
+	OPTION_SHADOW_EPDC,
+	OPTION_DITHER_EPDC,
+	OPTION_DITHER_LEVELS_EPDC,
+	OPTION_UPDATE_EPDC,
+	OPTION_MERGE_WASTE_EPDC,
+	OPTION_MAX_UPDATES_EPDC,
+	OPTION_WAVEFORM_EPDC,
+	OPTION_SMALL_AREA_EPDC,
+	OPTION_FULL_REFRESH_EPDC,
+	OPTION_FULL_REFRESH_COUNT_EPDC,
+	OPTION_FULL_REFRESH_AREA_EPDC,
+	OPTION_FULL_REFRESH_DELAY_EPDC,
+	OPTION_UPDATE_RATE_EPDC,
+	OPTION_FAST_PATH_EPDC,
 	OPTION_NOACCEL,
-	OPTION_ACCELMETHOD
+	OPTION_ACCELMETHOD,
+	OPTION_ACCEL_THREADS,
+	OPTION_OFFSCREEN_EVICTION
 } IMXOpts;
 
 #define	OPTION_STR_FBDEV	"fbdev"
 #define	OPTION_STR_FORMAT_EPDC	"FormatEPDC"
+#define	OPTION_STR_SHADOW_EPDC	"ShadowEPDC"
+#define	OPTION_STR_DITHER_EPDC	"DitherEPDC"
+#define	OPTION_STR_DITHER_LEVELS_EPDC	"DitherLevelsEPDC"
+#define	OPTION_STR_UPDATE_EPDC	"UpdateEPDC"
+#define	OPTION_STR_MERGE_WASTE_EPDC	"MergeWasteEPDC"
+#define	OPTION_STR_MAX_UPDATES_EPDC	"MaxUpdatesEPDC"
+#define	OPTION_STR_WAVEFORM_EPDC	"WaveformEPDC"
+#define	OPTION_STR_SMALL_AREA_EPDC	"SmallAreaEPDC"
+#define	OPTION_STR_FULL_REFRESH_EPDC	"FullRefreshEPDC"
+#define	OPTION_STR_FULL_REFRESH_COUNT_EPDC	"FullRefreshCountEPDC"
+#define	OPTION_STR_FULL_REFRESH_AREA_EPDC	"FullRefreshAreaEPDC"
+#define	OPTION_STR_FULL_REFRESH_DELAY_EPDC	"FullRefreshDelayEPDC"
+#define	OPTION_STR_UPDATE_RATE_EPDC	"UpdateRateEPDC"
+#define	OPTION_STR_FAST_PATH_EPDC	"FastPathEPDC"
 #define	OPTION_STR_NOACCEL	"NoAccel"
 #define	OPTION_STR_ACCELMETHOD	"AccelMethod"
+#define	OPTION_STR_ACCEL_THREADS	"AccelThreads"
+#define	OPTION_STR_OFFSCREEN_EVICTION	"OffscreenEviction"
 
 static const OptionInfoRec imxOptions[] = {
 	{ OPTION_FBDEV,		OPTION_STR_FBDEV,	OPTV_STRING,	{0},	FALSE },
 	{ OPTION_FORMAT_EPDC,	OPTION_STR_FORMAT_EPDC,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_SHADOW_EPDC,	OPTION_STR_SHADOW_EPDC,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_DITHER_EPDC,	OPTION_STR_DITHER_EPDC,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_DITHER_LEVELS_EPDC,	OPTION_STR_DITHER_LEVELS_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_UPDATE_EPDC,	OPTION_STR_UPDATE_EPDC,	OPTV_BOOLEAN,	{0},	FALSE },
+	{ OPTION_MERGE_WASTE_EPDC,	OPTION_STR_MERGE_WASTE_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_MAX_UPDATES_EPDC,	OPTION_STR_MAX_UPDATES_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_WAVEFORM_EPDC,	OPTION_STR_WAVEFORM_EPDC,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_SMALL_AREA_EPDC,	OPTION_STR_SMALL_AREA_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_FULL_REFRESH_EPDC,	OPTION_STR_FULL_REFRESH_EPDC,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_FULL_REFRESH_COUNT_EPDC,	OPTION_STR_FULL_REFRESH_COUNT_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_FULL_REFRESH_AREA_EPDC,	OPTION_STR_FULL_REFRESH_AREA_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_FULL_REFRESH_DELAY_EPDC,	OPTION_STR_FULL_REFRESH_DELAY_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_UPDATE_RATE_EPDC,	OPTION_STR_UPDATE_RATE_EPDC,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_FAST_PATH_EPDC,	OPTION_STR_FAST_PATH_EPDC,	OPTV_INTEGER,	{0},	FALSE },
 	{ OPTION_NOACCEL,	OPTION_STR_NOACCEL,	OPTV_BOOLEAN,	{0},	FALSE },
 	{ OPTION_ACCELMETHOD,	OPTION_STR_ACCELMETHOD,	OPTV_STRING,	{0},	FALSE },
+	{ OPTION_ACCEL_THREADS,	OPTION_STR_ACCEL_THREADS,	OPTV_INTEGER,	{0},	FALSE },
+	{ OPTION_OFFSCREEN_EVICTION,	OPTION_STR_OFFSCREEN_EVICTION,	OPTV_STRING,	{0},	FALSE },
 	{ -1,			NULL,			OPTV_NONE,	{0},	FALSE }
 };
 
@@ -161,7 +210,8 @@ imxGetRec(ScrnInfoPtr pScrn)
 /* -------------------------------------------------------------------- */
 
 static Bool
-imxPreInitEPDC(ScrnInfoPtr pScrn, ImxPtr fPtr, int fd, char* strFormat)
+imxPreInitEPDC(ScrnInfoPtr pScrn, ImxPtr fPtr, int fd, char* strFormat,
+		char* strShadow)
 {
 	Bool result = TRUE;
 
@@ -205,6 +255,41 @@ imxPreInitEPDC(ScrnInfoPtr pScrn, ImxPtr fPtr, int fd, char* strFormat)
 		return FALSE;
 	}
 
+	/* Y8INV panels show 0 as white */
+	fPtr->epdcInverted =
+		(GRAYSCALE_8BIT_INVERTED == fbVarScreenInfo.grayscale);
+
+	/* Find the requested shadow format for X to render in */
+	fPtr->epdcShadowBpp = 0;
+	if (NULL != strShadow) {
+		if (0 == xf86NameCmp(strShadow, "off")) {
+			fPtr->epdcShadowBpp = 0;
+		}
+		else if (0 == xf86NameCmp(strShadow, "RGB565")) {
+			fPtr->epdcShadowBpp = 16;
+		}
+		else if (0 == xf86NameCmp(strShadow, "XRGB8888")) {
+			fPtr->epdcShadowBpp = 32;
+		}
+		else {
+			xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+				"\"%s\" is not a valid value for Option \"%s\"\n", strShadow, OPTION_STR_SHADOW_EPDC);
+			xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+				"valid options are \"off\", \"RGB565\" and \"XRGB8888\"\n");
+			return FALSE;
+		}
+	}
+
+	/* The shadow is converted to 8-bit gray only */
+	if ((0 != fPtr->epdcShadowBpp) &&
+		(8 != fbVarScreenInfo.bits_per_pixel)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+			"Option \"%s\" needs an 8-bit gray \"%s\", ignored\n",
+			OPTION_STR_SHADOW_EPDC, OPTION_STR_FORMAT_EPDC);
+		fPtr->epdcShadowBpp = 0;
+	}
+
 	return TRUE;
 }
 
@@ -272,13 +357,18 @@ imxPreInit(ScrnInfoPtr pScrn, int flags)
 	strcpy(fPtr->fbDeviceName, fbdevName + 5); // skip past "/dev/"
 
 	/* Special case for EPDC driver */
-	if (ImxFbTypeEPDC == imxDisplayGetFrameBufferType(&fbFixScreenInfo)) {
+	fPtr->isEPDC =
+		(ImxFbTypeEPDC == imxDisplayGetFrameBufferType(&fbFixScreenInfo));
+	if (fPtr->isEPDC) {
 
 		/* Get the format for the EPDC */
 		char* strFormat = xf86FindOptionValue(fPtr->pEntity->device->options, OPTION_STR_FORMAT_EPDC);
 
+		/* Get the format X renders in when shadowing the EPDC */
+		char* strShadow = xf86FindOptionValue(fPtr->pEntity->device->options, OPTION_STR_SHADOW_EPDC);
+
 		/* Perform pre-init on EPDC */
-		if (!imxPreInitEPDC(pScrn, fPtr, fd, strFormat)) {
+		if (!imxPreInitEPDC(pScrn, fPtr, fd, strFormat, strShadow)) {
 			close(fd);
 			goto errorPreInit;
 		}
@@ -290,6 +380,12 @@ imxPreInit(ScrnInfoPtr pScrn, int flags)
 		goto errorPreInit;
 	}
 	default_depth = fbdevHWGetDepth(pScrn,&fbbpp);
+
+	/* X renders into the shadow, not into the gray frame buffer */
+	if (0 != fPtr->epdcShadowBpp) {
+		fbbpp = fPtr->epdcShadowBpp;
+		default_depth = (16 == fbbpp) ? 16 : 24;
+	}
 	if (!xf86SetDepthBpp(pScrn, default_depth, default_depth, fbbpp,
 			     Support24bppFb | Support32bppFb | SupportConvert32to24 | SupportConvert24to32)) {
 		goto errorPreInit;
@@ -338,10 +434,240 @@ imxPreInit(ScrnInfoPtr pScrn, int flags)
 	memcpy(fPtr->pOptions, imxOptions, sizeof(imxOptions));
 	xf86ProcessOptions(pScrn->scrnIndex, fPtr->pEntity->device->options, fPtr->pOptions);
 
-	/* NoAccel option */
-  fPtr->useAccel = FALSE;
+	/* UpdateEPDC option */
+	fPtr->epdcUpdate = fPtr->isEPDC &&
+		xf86ReturnOptValBool(fPtr->pOptions, OPTION_UPDATE_EPDC, TRUE);
 
-	/* AccelMethod option */
+	/* Only the update engine converts the shadow for the panel */
+	if ((0 != fPtr->epdcShadowBpp) && !fPtr->epdcUpdate) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+			"Option \"%s\" needs Option \"%s\"\n",
+			OPTION_STR_SHADOW_EPDC, OPTION_STR_UPDATE_EPDC);
+		goto errorPreInit;
+	}
+
+	/* DitherEPDC option */
+	fPtr->epdcDither = ImxEpdcDitherNone;
+	const char* strDither =
+		xf86GetOptValString(fPtr->pOptions, OPTION_DITHER_EPDC);
+	if (NULL != strDither) {
+		if (0 == xf86NameCmp(strDither, "none")) {
+			fPtr->epdcDither = ImxEpdcDitherNone;
+		}
+		else if (0 == xf86NameCmp(strDither, "ordered")) {
+			fPtr->epdcDither = ImxEpdcDitherOrdered;
+		}
+		else if (0 == xf86NameCmp(strDither, "diffusion")) {
+			fPtr->epdcDither = ImxEpdcDitherDiffusion;
+		}
+		else {
+			xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+				"\"%s\" is not a valid value for Option \"%s\"\n", strDither, OPTION_STR_DITHER_EPDC);
+			xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+				"valid options are \"none\", \"ordered\" and \"diffusion\"\n");
+		}
+	}
+
+	/* Only the shadow has more levels than the panel to dither */
+	if ((ImxEpdcDitherNone != fPtr->epdcDither) &&
+		(0 == fPtr->epdcShadowBpp)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+			"Option \"%s\" needs Option \"%s\", ignored\n",
+			OPTION_STR_DITHER_EPDC, OPTION_STR_SHADOW_EPDC);
+		fPtr->epdcDither = ImxEpdcDitherNone;
+	}
+
+	/* DitherLevelsEPDC option */
+	fPtr->epdcDitherLevels = 16;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_DITHER_LEVELS_EPDC,
+				&fPtr->epdcDitherLevels);
+	if ((16 != fPtr->epdcDitherLevels) && (2 != fPtr->epdcDitherLevels)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+			"Option \"%s\" must be 16 or 2, using 16\n",
+			OPTION_STR_DITHER_LEVELS_EPDC);
+		fPtr->epdcDitherLevels = 16;
+	}
+
+	/* MergeWasteEPDC option (percent of an update allowed to be */
+	/* pixels that were not damaged) */
+	fPtr->epdcMergeWaste = 25;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_MERGE_WASTE_EPDC,
+				&fPtr->epdcMergeWaste);
+	if (fPtr->epdcMergeWaste < 0) {
+		fPtr->epdcMergeWaste = 0;
+	}
+
+	/* MaxUpdatesEPDC option */
+	fPtr->epdcMaxUpdates = 4;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_MAX_UPDATES_EPDC,
+				&fPtr->epdcMaxUpdates);
+	if (fPtr->epdcMaxUpdates < 1) {
+		fPtr->epdcMaxUpdates = 1;
+	} else if (fPtr->epdcMaxUpdates > IMX_EPDC_MAX_UPDATES) {
+		fPtr->epdcMaxUpdates = IMX_EPDC_MAX_UPDATES;
+	}
+
+	/* WaveformEPDC option */
+	fPtr->epdcWaveform = ImxEpdcWaveformAuto;
+	const char* strWaveform =
+		xf86GetOptValString(fPtr->pOptions, OPTION_WAVEFORM_EPDC);
+	if (NULL != strWaveform) {
+		if (0 == xf86NameCmp(strWaveform, "auto")) {
+			fPtr->epdcWaveform = ImxEpdcWaveformAuto;
+		}
+		else if (0 == xf86NameCmp(strWaveform, "kernel")) {
+			fPtr->epdcWaveform = ImxEpdcWaveformKernel;
+		}
+		else if (0 == xf86NameCmp(strWaveform, "DU")) {
+			fPtr->epdcWaveform = ImxEpdcWaveformDU;
+		}
+		else if (0 == xf86NameCmp(strWaveform, "GC4")) {
+			fPtr->epdcWaveform = ImxEpdcWaveformGC4;
+		}
+		else if (0 == xf86NameCmp(strWaveform, "GC16")) {
+			fPtr->epdcWaveform = ImxEpdcWaveformGC16;
+		}
+		else {
+			xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+				"\"%s\" is not a valid value for Option \"%s\"\n", strWaveform, OPTION_STR_WAVEFORM_EPDC);
+			xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+				"valid options are \"auto\", \"kernel\", \"DU\", \"GC4\" and \"GC16\"\n");
+		}
+	}
+
+	/* SmallAreaEPDC option (updates up to this many pixels always */
+	/* use the fastest waveform when selecting automatically) */
+	fPtr->epdcSmallArea = 4096;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_SMALL_AREA_EPDC,
+				&fPtr->epdcSmallArea);
+	if (fPtr->epdcSmallArea < 0) {
+		fPtr->epdcSmallArea = 0;
+	}
+
+	/* FullRefreshEPDC option */
+	fPtr->epdcFullRefresh = ImxEpdcRefreshRegion;
+	const char* strFullRefresh =
+		xf86GetOptValString(fPtr->pOptions, OPTION_FULL_REFRESH_EPDC);
+	if (NULL != strFullRefresh) {
+		if (0 == xf86NameCmp(strFullRefresh, "off")) {
+			fPtr->epdcFullRefresh = ImxEpdcRefreshOff;
+		}
+		else if (0 == xf86NameCmp(strFullRefresh, "region")) {
+			fPtr->epdcFullRefresh = ImxEpdcRefreshRegion;
+		}
+		else if (0 == xf86NameCmp(strFullRefresh, "screen")) {
+			fPtr->epdcFullRefresh = ImxEpdcRefreshScreen;
+		}
+		else {
+			xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+				"\"%s\" is not a valid value for Option \"%s\"\n", strFullRefresh, OPTION_STR_FULL_REFRESH_EPDC);
+			xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+				"valid options are \"off\", \"region\" and \"screen\"\n");
+		}
+	}
+
+	/* FullRefreshCountEPDC option (partial updates of a tile before */
+	/* it gets a flashing refresh, 0 to ignore the count) */
+	fPtr->epdcRefreshCount = 32;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_FULL_REFRESH_COUNT_EPDC,
+				&fPtr->epdcRefreshCount);
+	if (fPtr->epdcRefreshCount < 0) {
+		fPtr->epdcRefreshCount = 0;
+	}
+
+	/* FullRefreshAreaEPDC option (percent of a tile covered by */
+	/* partial updates before it gets a flashing refresh, 0 to */
+	/* ignore the area) */
+	fPtr->epdcRefreshArea = 800;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_FULL_REFRESH_AREA_EPDC,
+				&fPtr->epdcRefreshArea);
+	if (fPtr->epdcRefreshArea < 0) {
+		fPtr->epdcRefreshArea = 0;
+	}
+
+	/* FullRefreshDelayEPDC option (idle milliseconds to wait) */
+	fPtr->epdcRefreshDelay = 2000;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_FULL_REFRESH_DELAY_EPDC,
+				&fPtr->epdcRefreshDelay);
+	if (fPtr->epdcRefreshDelay < 1) {
+		fPtr->epdcRefreshDelay = 1;
+	}
+	if ((0 == fPtr->epdcRefreshCount) && (0 == fPtr->epdcRefreshArea)) {
+		fPtr->epdcFullRefresh = ImxEpdcRefreshOff;
+	}
+
+	/* UpdateRateEPDC option (updates per second for any part of */
+	/* the screen, 0 for no limit) */
+	fPtr->epdcUpdateRate = 4;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_UPDATE_RATE_EPDC,
+				&fPtr->epdcUpdateRate);
+	if (fPtr->epdcUpdateRate < 0) {
+		fPtr->epdcUpdateRate = 0;
+	} else if (fPtr->epdcUpdateRate > 1000) {
+		fPtr->epdcUpdateRate = 1000;
+	}
+
+	/* FastPathEPDC option (milliseconds after input during which */
+	/* small updates are not rate limited, 0 to disable) */
+	fPtr->epdcFastPath = 500;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_FAST_PATH_EPDC,
+				&fPtr->epdcFastPath);
+	if (fPtr->epdcFastPath < 0) {
+		fPtr->epdcFastPath = 0;
+	}
+
+	/* AccelMethod option (only the EXA software kernels for now); */
+	/* acceleration stays off unless a method is asked for */
+	fPtr->useAccel = FALSE;
+	fPtr->useAccelComposite = FALSE;
+	s = xf86GetOptValString(fPtr->pOptions, OPTION_ACCELMETHOD);
+	if (NULL == s) {
+
+		/* Default: no acceleration */
+
+	} else if (0 == xf86NameCmp(s, "EXA")) {
+
+		/* Fills, copies and composite */
+		fPtr->useAccel = TRUE;
+		fPtr->useAccelComposite = TRUE;
+
+	} else if (0 == xf86NameCmp(s, "EXA-NoComposite")) {
+
+		/* Render composite left to fb */
+		fPtr->useAccel = TRUE;
+
+	} else if (0 != xf86NameCmp(s, "none")) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unknown %s '%s', acceleration disabled\n",
+			OPTION_STR_ACCELMETHOD, s);
+	}
+
+	/* NoAccel option overrides AccelMethod */
+	if (xf86ReturnOptValBool(fPtr->pOptions, OPTION_NOACCEL, FALSE)) {
+		fPtr->useAccel = FALSE;
+		fPtr->useAccelComposite = FALSE;
+	}
+
+	/* AccelThreads option; negative means one per additional core */
+	fPtr->accelThreads = -1;
+	xf86GetOptValInteger(fPtr->pOptions, OPTION_ACCEL_THREADS,
+				&fPtr->accelThreads);
+
+	/* OffscreenEviction option; NULL for the default policy */
+	fPtr->offscreenEviction =
+		xf86GetOptValString(fPtr->pOptions, OPTION_OFFSCREEN_EVICTION);
+
+	/* Load the EXA module. */
+	if (fPtr->useAccel && (NULL == xf86LoadSubModule(pScrn, "exa"))) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unable to load EXA module, acceleration disabled\n");
+		fPtr->useAccel = FALSE;
+	}
 
 	/* Display pre-init */
 	if (!imxDisplayPreInit(pScrn)) {
@@ -422,12 +748,32 @@ imxCloseScreen(CLOSE_SCREEN_ARGS_DECL)
 	CLOSE_SCREEN_DECL_ScrnInfoPtr;
 	ImxPtr fPtr = IMXPTR(pScrn);
 
+	if (fPtr->epdcUpdate) {
+		imxEpdcCloseScreen(pScreen);
+	}
+
+	/* Screen functions wrapped on top of EXA go first */
+	if (fPtr->useAccel) {
+		imxExaUnwrapScreen(pScreen);
+	}
+
 	fbdevHWRestore(pScrn);
 	fbdevHWUnmapVidmem(pScrn);
 	pScrn->vtSema = FALSE;
 
 	pScreen->CloseScreen = fPtr->saveCloseScreen;
-	return (*pScreen->CloseScreen)(CLOSE_SCREEN_ARGS);
+	Bool ret = (*pScreen->CloseScreen)(CLOSE_SCREEN_ARGS);
+
+	/* Screen pixmap is gone, so the shadow can go too */
+	free(fPtr->epdcShadowMemory);
+	fPtr->epdcShadowMemory = NULL;
+
+	/* So are the pixmaps in offscreen memory */
+	if (fPtr->useAccel) {
+		imxExaCloseScreen(pScreen);
+	}
+
+	return ret;
 }
 
 static int
@@ -517,7 +863,9 @@ imxScreenInit(SCREEN_INIT_ARGS_DECL)
 	fbMaxHeight = IMX_ALIGN(fbMaxHeight, fPtr->fbAlignHeight);
 
 	/* What is aligned bytes per line? */
-	const int fbBytesPerPixel = (pScrn->bitsPerPixel + 7) / 8;
+	/* (with an EPDC shadow the frame buffer holds 8-bit gray) */
+	const int fbBytesPerPixel = (0 != fPtr->epdcShadowBpp) ?
+		1 : (pScrn->bitsPerPixel + 7) / 8;
 	const int fbBytesPerLine = fbMaxWidth * fbBytesPerPixel;
 
 	/* Compute the offset alignment which is least common multiple */
@@ -552,6 +900,28 @@ imxScreenInit(SCREEN_INIT_ARGS_DECL)
 		return FALSE;
 	}
 
+	/* X renders into system memory when shadowing the EPDC, large */
+	/* enough for the biggest screen the frame buffer allows. */
+	unsigned char* pScreenMemory = fPtr->fbMemoryStart;
+	if (0 != fPtr->epdcShadowBpp) {
+
+		const int shadowWidth = (pScrn->displayWidth > fbMaxWidth) ?
+			pScrn->displayWidth : fbMaxWidth;
+		fPtr->epdcShadowMemory = calloc(
+			shadowWidth * fbMaxHeight, fPtr->epdcShadowBpp / 8);
+		if (NULL == fPtr->epdcShadowMemory) {
+
+			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+				"unable to allocate EPDC shadow memory\n");
+			return FALSE;
+		}
+		pScreenMemory = fPtr->epdcShadowMemory;
+
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			"rendering into %d bpp shadow of EPDC frame buffer\n",
+			fPtr->epdcShadowBpp);
+	}
+
 	/* mi layer */
 	miClearVisualTypes();
 	if (pScrn->bitsPerPixel > 8) {
@@ -599,7 +969,7 @@ imxScreenInit(SCREEN_INIT_ARGS_DECL)
 		case 16:
 		case 24:
 		case 32:
-			ret = fbScreenInit(pScreen, fPtr->fbMemoryStart,
+			ret = fbScreenInit(pScreen, pScreenMemory,
 					   pScrn->virtualX, pScrn->virtualY,
 					   pScrn->xDpi, pScrn->yDpi,
 					   pScrn->displayWidth,
@@ -671,10 +1041,29 @@ imxScreenInit(SCREEN_INIT_ARGS_DECL)
 	xf86SetBlackWhitePixels(pScreen);
 
 	/* INIT ACCELERATION BEFORE INIT FOR BACKING STORE & SOFTWARE CURSOR */ 
-  fPtr->useAccel = FALSE;
+	if (fPtr->useAccel && !imxExaSetup(pScreen)) {
+
+		fPtr->useAccel = FALSE;
+	}
 
-	/* note if acceleration is in use */
-  xf86DrvMsg(pScrn->scrnIndex, X_INFO, "No acceleration in use\n");
+	/* note which CPU kernels and whether acceleration are in use */
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		"%s CPU kernels in use, block copies from %d bytes per row\n",
+		imx_accel_name(), imx_accel_copy_threshold());
+	if (fPtr->useAccel) {
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			"EXA software acceleration in use\n");
+	} else {
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO, "No acceleration in use\n");
+	}
+
+	/* Drive EPDC panel updates from screen damage */
+	if (fPtr->epdcUpdate && !imxEpdcScreenInit(pScreen)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+			"EPDC update engine initialization failed\n");
+		return FALSE;
+	}
 
 
 	/* Initialize for X extensions. */
@@ -760,9 +1149,18 @@ IMXGetPixmapProperties(
 	void** pPhysAddr,
 	int* pPitch)
 {
+	/* Access screen associated with this pixmap */
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pPixmap->drawable.pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr fPtr = IMXPTR(pScrn);
+
+	/* not supported when acceleration turned off */
+	if (!fPtr->useAccel) {
+		return FALSE;
+	}
 
-  /* not supported when acceleration turned off */
-  return FALSE;
+	return imxExaGetPixmapProperties(pPixmap, pPhysAddr, pPitch);
 }
 
 static Bool
@@ -902,6 +1300,10 @@ imxSetup(pointer module, pointer opts, int *errmaj, int *errmin)
 
 	if (!setupDone) {
 		setupDone = TRUE;
+
+		/* Pick the CPU kernels this processor can run */
+		imx_accel_init();
+
 		xf86AddDriver(&imxDriver, module, HaveDriverFuncs);
 		return (pointer)1;
 	} else {
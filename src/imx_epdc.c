@@ -0,0 +1,1476 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * EPDC update engine.
+ *
+ * An EPDC panel only changes what is shown when the controller is told
+ * which region of the frame buffer to drive a waveform through.  The
+ * screen pixmap is tracked with a damage object and, each time the server
+ * is about to block, the damaged region is reduced to a few update
+ * rectangles (see imx_epdc_region.c) which are sent to the controller.
+ *
+ * Updates are submitted without waiting for the waveform to finish.  Each
+ * one carries a marker and a reaper thread waits on the markers in the
+ * order they were sent.  Completions are reported back to the server
+ * through a pipe in its select set, so nothing in the main loop blocks
+ * unless the driver or a client explicitly asks to wait for a marker.
+ *
+ * An update overlapping one still in flight would only be serialized by
+ * the controller, so it is held back until its predecessor completes.
+ * Redraws of the held back area in the meantime (spinners, progress
+ * bars) are folded into it and cost a single waveform.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <linux/fb.h>
+#include <linux/mxcfb.h>
+
+#include "xf86.h"
+#include "os.h"
+#include "dix.h"
+#include <X11/extensions/XI2.h>
+#include "fbdevhw.h"
+#include "damage.h"
+#include "xorgVersion.h"
+
+#include "compat-api.h"
+
+#include "imx.h"
+#include "imx_accel.h"
+#include "imx_epdc.h"
+
+/* DamageUnregister lost its drawable argument in server 1.15 */
+#if XORG_VERSION_CURRENT >= XORG_VERSION_NUMERIC(1,14,99,2,0)
+#define IMX_DAMAGE_UNREGISTER(pDrawable, pDamage) DamageUnregister(pDamage)
+#else
+#define IMX_DAMAGE_UNREGISTER(pDrawable, pDamage) \
+	DamageUnregister(pDrawable, pDamage)
+#endif
+
+/* Updates the driver keeps track of until the EPDC completes them */
+#define	IMX_EPDC_MAX_IN_FLIGHT		64
+
+/* Ghosting over this share of the screen gets a full screen refresh */
+#define	IMX_EPDC_REFRESH_SCREEN_PERCENT	50
+
+/* Size of the tiles update rates are limited in */
+#define	IMX_EPDC_PACE_TILE		64
+
+/* Milliseconds before a refresh held back by a collision is retried */
+#define	IMX_EPDC_REFRESH_RETRY		50
+
+/* -------------------------------------------------------------------- */
+
+typedef struct {
+
+	__u32		marker;
+	BoxRec		box;
+
+} ImxEpdcUpdateRec;
+
+typedef struct _ImxEpdcNotifyRec {
+
+	struct _ImxEpdcNotifyRec*	next;
+
+	__u32				marker;
+	ImxEpdcNotifyProcPtr		notify;
+	pointer				closure;
+
+} ImxEpdcNotifyRec, *ImxEpdcNotifyPtr;
+
+typedef struct {
+
+	/* Screen functions wrapped by the update engine */
+	CreateScreenResourcesProcPtr	saveCreateScreenResources;
+	ScreenBlockHandlerProcPtr	saveBlockHandler;
+
+	/* Accumulates screen pixmap damage between flushes */
+	DamagePtr			pDamage;
+	PixmapPtr			pDamagePixmap;
+
+	/* FB driver fd, also used by the reaper thread */
+	int				fdDev;
+
+	/* Marker sent with the most recent update */
+	__u32				updateMarker;
+
+	/* Updates held back until the one they collide with completes */
+	RegionRec			postponedRegion;
+
+	/* Set when the whole panel has to be redrawn, such as after */
+	/* the frame buffer was rotated. */
+	Bool				redrawScreen;
+
+	/* Time each pacing tile was last updated, NULL when the */
+	/* update rate is not limited */
+	CARD32*				paceLastSent;
+	int				paceTilesX;
+	int				paceTilesY;
+	int				paceInterval;
+
+	/* Wakes the server when held back updates may be sent */
+	OsTimerPtr			paceTimer;
+
+	/* Counters reported through the imx-ext extension */
+	ImxEpdcStatsRec			stats;
+
+	/* Ghosting left by partial updates, NULL if not accounted */
+	ImxEpdcGhostPtr			pGhost;
+
+	/* Fires once the screen was idle long enough to refresh */
+	OsTimerPtr			refreshTimer;
+
+	/* Gray pixels of the box being dithered, sized for the whole */
+	/* screen; NULL when not dithering */
+	unsigned char*			pGray;
+
+	/* Everything below is shared with the reaper thread and */
+	/* protected by the mutex. */
+	pthread_mutex_t			mutex;
+	pthread_cond_t			condSubmit;
+	pthread_cond_t			condComplete;
+	pthread_t			reaperThread;
+	Bool				reaperRunning;
+	Bool				reaperExit;
+
+	/* Ring of submitted updates in the order they were sent. */
+	/* The first inFlightReaped entries have completed but are */
+	/* not yet retired by the server. */
+	ImxEpdcUpdateRec		inFlight[IMX_EPDC_MAX_IN_FLIGHT];
+	int				inFlightHead;
+	int				inFlightCount;
+	int				inFlightReaped;
+
+	/* Every marker up to this one has completed */
+	__u32				completedMarker;
+
+	/* Reaper writes a byte here for each completed update */
+	int				notifyPipe[2];
+
+	/* Waiting for markers to complete, only used by the server */
+	ImxEpdcNotifyPtr		notifyList;
+
+} ImxEpdcRec, *ImxEpdcPtr;
+
+#define IMXEPDCPTR(imxPtr) ((ImxEpdcPtr)((imxPtr)->epdcPrivate))
+
+/* -------------------------------------------------------------------- */
+
+static ImxEpdcPtr
+imxEpdcGetScreenPrivate(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Screen may be driven by some other driver */
+	if ((NULL == pScrn) || (NULL == pScrn->driverName) ||
+		(0 != strcmp(pScrn->driverName, IMX_DRIVER_NAME))) {
+		return NULL;
+	}
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+	if (NULL == imxPtr) {
+		return NULL;
+	}
+
+	return IMXEPDCPTR(imxPtr);
+}
+
+/* Marker serial numbers wrap, so compare them the way TCP does */
+static Bool
+imxEpdcMarkerDone(__u32 completedMarker, __u32 marker)
+{
+	return (int)(marker - completedMarker) <= 0;
+}
+
+/* A marker that was never sent would never complete */
+static __u32
+imxEpdcClampMarker(ImxEpdcPtr fPtr, __u32 marker)
+{
+	if ((int)(marker - fPtr->updateMarker) > 0) {
+		return fPtr->updateMarker;
+	}
+	return marker;
+}
+
+/* -------------------------------------------------------------------- */
+
+static void*
+imxEpdcReaperThread(void* arg)
+{
+	ImxEpdcPtr fPtr = arg;
+
+	pthread_mutex_lock(&fPtr->mutex);
+
+	while (!fPtr->reaperExit) {
+
+		/* Anything submitted but not yet reaped? */
+		if (fPtr->inFlightReaped >= fPtr->inFlightCount) {
+
+			pthread_cond_wait(&fPtr->condSubmit, &fPtr->mutex);
+			continue;
+		}
+
+		const int index = (fPtr->inFlightHead + fPtr->inFlightReaped) %
+					IMX_EPDC_MAX_IN_FLIGHT;
+		__u32 marker = fPtr->inFlight[index].marker;
+
+		/* The EPDC driver blocks until the waveform for this */
+		/* marker is done (the kernels this driver targets take a */
+		/* bare marker rather than struct mxcfb_update_marker_data) */
+		/* or gives up after its own timeout.  Either way the */
+		/* update is no longer in flight. */
+		pthread_mutex_unlock(&fPtr->mutex);
+		ioctl(fPtr->fdDev, MXCFB_WAIT_FOR_UPDATE_COMPLETE, &marker);
+		pthread_mutex_lock(&fPtr->mutex);
+
+		++fPtr->inFlightReaped;
+		fPtr->completedMarker = marker;
+		pthread_cond_broadcast(&fPtr->condComplete);
+
+		/* Wake up the server; a full pipe already will */
+		const char byte = 0;
+		if (-1 == write(fPtr->notifyPipe[1], &byte, 1)) {
+			/* nothing to do */
+		}
+	}
+
+	pthread_mutex_unlock(&fPtr->mutex);
+	return NULL;
+}
+
+static void
+imxEpdcRetireCompleted(ImxEpdcPtr fPtr)
+{
+	/* Drop completed updates from the ring */
+	pthread_mutex_lock(&fPtr->mutex);
+	fPtr->inFlightHead = (fPtr->inFlightHead + fPtr->inFlightReaped) %
+				IMX_EPDC_MAX_IN_FLIGHT;
+	fPtr->inFlightCount -= fPtr->inFlightReaped;
+	fPtr->inFlightReaped = 0;
+	const __u32 completedMarker = fPtr->completedMarker;
+	pthread_mutex_unlock(&fPtr->mutex);
+
+	/* Tell whoever was waiting for a marker that has completed, */
+	/* going by the copy taken under the lock as the reaper keeps */
+	/* updating it.  Callbacks may add new entries, so unlink */
+	/* before calling. */
+	ImxEpdcNotifyPtr* ppNotify = &fPtr->notifyList;
+	while (NULL != *ppNotify) {
+
+		ImxEpdcNotifyPtr pNotify = *ppNotify;
+		if (!imxEpdcMarkerDone(completedMarker, pNotify->marker)) {
+
+			ppNotify = &pNotify->next;
+			continue;
+		}
+
+		*ppNotify = pNotify->next;
+		(*pNotify->notify)(pNotify->closure, pNotify->marker);
+		free(pNotify);
+	}
+}
+
+static void
+imxEpdcWakeupHandler(pointer blockData, int result, pointer pReadmask)
+{
+	ScrnInfoPtr pScrn = blockData;
+	ImxPtr imxPtr = IMXPTR(pScrn);
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	if ((result <= 0) ||
+		!FD_ISSET(fPtr->notifyPipe[0], (fd_set*)pReadmask)) {
+		return;
+	}
+
+	/* Drain the notifications; the ring holds the details */
+	char bytes[64];
+	while (read(fPtr->notifyPipe[0], bytes, sizeof(bytes)) > 0) {
+		/* nothing to do */
+	}
+
+	imxEpdcRetireCompleted(fPtr);
+}
+
+static void
+imxEpdcNoopBlockHandler(pointer blockData, OSTimePtr pTimeout,
+			pointer pReadmask)
+{
+	/* nothing to do; updates are flushed by the screen BlockHandler */
+}
+
+static Bool
+imxEpdcStartReaper(ScrnInfoPtr pScrn, ImxEpdcPtr fPtr)
+{
+	if (-1 == pipe(fPtr->notifyPipe)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unable to create EPDC notify pipe: %s\n",
+			strerror(errno));
+		return FALSE;
+	}
+	fcntl(fPtr->notifyPipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(fPtr->notifyPipe[1], F_SETFL, O_NONBLOCK);
+
+	fPtr->reaperExit = FALSE;
+	if (0 != pthread_create(&fPtr->reaperThread, NULL,
+					imxEpdcReaperThread, fPtr)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unable to start EPDC update reaper thread\n");
+		close(fPtr->notifyPipe[0]);
+		close(fPtr->notifyPipe[1]);
+		return FALSE;
+	}
+	fPtr->reaperRunning = TRUE;
+
+	AddGeneralSocket(fPtr->notifyPipe[0]);
+	RegisterBlockAndWakeupHandlers(imxEpdcNoopBlockHandler,
+					imxEpdcWakeupHandler, pScrn);
+
+	return TRUE;
+}
+
+static void
+imxEpdcStopReaper(ScrnInfoPtr pScrn, ImxEpdcPtr fPtr)
+{
+	if (!fPtr->reaperRunning) {
+		return;
+	}
+
+	RemoveBlockAndWakeupHandlers(imxEpdcNoopBlockHandler,
+					imxEpdcWakeupHandler, pScrn);
+	RemoveGeneralSocket(fPtr->notifyPipe[0]);
+
+	pthread_mutex_lock(&fPtr->mutex);
+	fPtr->reaperExit = TRUE;
+	pthread_cond_signal(&fPtr->condSubmit);
+	pthread_mutex_unlock(&fPtr->mutex);
+
+	pthread_join(fPtr->reaperThread, NULL);
+	fPtr->reaperRunning = FALSE;
+
+	close(fPtr->notifyPipe[0]);
+	close(fPtr->notifyPipe[1]);
+
+	/* Nobody is going to complete these anymore */
+	while (NULL != fPtr->notifyList) {
+
+		ImxEpdcNotifyPtr pNotify = fPtr->notifyList;
+		fPtr->notifyList = pNotify->next;
+		(*pNotify->notify)(pNotify->closure, pNotify->marker);
+		free(pNotify);
+	}
+}
+
+/* -------------------------------------------------------------------- */
+
+static Bool
+imxEpdcSendUpdate(ScrnInfoPtr pScrn, BoxPtr pBox, int waveformMode,
+			int updateMode)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	/* When the ring is full the oldest update has to finish first */
+	if (fPtr->reaperRunning) {
+
+		pthread_mutex_lock(&fPtr->mutex);
+		while (fPtr->inFlightCount - fPtr->inFlightReaped >=
+				IMX_EPDC_MAX_IN_FLIGHT) {
+
+			pthread_cond_wait(&fPtr->condComplete, &fPtr->mutex);
+		}
+		pthread_mutex_unlock(&fPtr->mutex);
+
+		imxEpdcRetireCompleted(fPtr);
+	}
+
+	/* Marker 0 means no marker to the EPDC driver, so skip it */
+	const __u32 lastMarker = fPtr->updateMarker;
+	if (0 == ++fPtr->updateMarker) {
+		++fPtr->updateMarker;
+	}
+
+	struct mxcfb_update_data updateData;
+	memset(&updateData, 0, sizeof(updateData));
+	updateData.update_region.left = pBox->x1;
+	updateData.update_region.top = pBox->y1;
+	updateData.update_region.width = pBox->x2 - pBox->x1;
+	updateData.update_region.height = pBox->y2 - pBox->y1;
+	updateData.waveform_mode = waveformMode;
+	updateData.update_mode = updateMode;
+	updateData.update_marker = fPtr->updateMarker;
+	updateData.temp = TEMP_USE_AMBIENT;
+	updateData.flags = 0;
+
+	if (-1 == ioctl(fPtr->fdDev, MXCFB_SEND_UPDATE, &updateData)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+			"MXCFB_SEND_UPDATE (%d,%d %dx%d): %s\n",
+			updateData.update_region.left,
+			updateData.update_region.top,
+			updateData.update_region.width,
+			updateData.update_region.height,
+			strerror(errno));
+
+		/* Nothing will complete this marker, so nobody may wait on it */
+		fPtr->updateMarker = lastMarker;
+		return FALSE;
+	}
+
+	++fPtr->stats.updatesSent;
+
+	/* Hand the marker to the reaper thread */
+	if (fPtr->reaperRunning) {
+
+		pthread_mutex_lock(&fPtr->mutex);
+		const int index = (fPtr->inFlightHead + fPtr->inFlightCount) %
+					IMX_EPDC_MAX_IN_FLIGHT;
+		fPtr->inFlight[index].marker = fPtr->updateMarker;
+		fPtr->inFlight[index].box = *pBox;
+		++fPtr->inFlightCount;
+		pthread_cond_signal(&fPtr->condSubmit);
+		pthread_mutex_unlock(&fPtr->mutex);
+	}
+
+	return TRUE;
+}
+
+/* Was there input recently enough for updates to skip pacing? */
+static Bool
+imxEpdcInputFastPath(ImxPtr imxPtr, CARD32 now)
+{
+	if (0 == imxPtr->epdcFastPath) {
+		return FALSE;
+	}
+
+	const CARD32 lastInput =
+		lastDeviceEventTime[XIAllDevices].milliseconds;
+	return (int)(now - lastInput) <= imxPtr->epdcFastPath;
+}
+
+/*
+ * Milliseconds until the box may be updated again without exceeding
+ * the update rate, 0 if it may be updated now.
+ */
+static int
+imxEpdcPaceDelay(ImxEpdcPtr fPtr, const BoxRec* pBox, CARD32 now)
+{
+	int delay = 0;
+
+	if (NULL == fPtr->paceLastSent) {
+		return 0;
+	}
+
+	const int tx1 = pBox->x1 / IMX_EPDC_PACE_TILE;
+	const int ty1 = pBox->y1 / IMX_EPDC_PACE_TILE;
+	const int tx2 = (pBox->x2 - 1) / IMX_EPDC_PACE_TILE;
+	const int ty2 = (pBox->y2 - 1) / IMX_EPDC_PACE_TILE;
+
+	int tx, ty;
+	for (ty = ty1; (ty <= ty2) && (ty < fPtr->paceTilesY); ++ty) {
+
+		const CARD32* pLastSent = fPtr->paceLastSent + ty * fPtr->paceTilesX;
+		for (tx = tx1; (tx <= tx2) && (tx < fPtr->paceTilesX); ++tx) {
+
+			const int tileDelay =
+				fPtr->paceInterval - (int)(now - pLastSent[tx]);
+			if (tileDelay > delay) {
+				delay = tileDelay;
+			}
+		}
+	}
+
+	return delay;
+}
+
+static void
+imxEpdcPaceMark(ImxEpdcPtr fPtr, const BoxRec* pBox, CARD32 now)
+{
+	if (NULL == fPtr->paceLastSent) {
+		return;
+	}
+
+	const int tx1 = pBox->x1 / IMX_EPDC_PACE_TILE;
+	const int ty1 = pBox->y1 / IMX_EPDC_PACE_TILE;
+	const int tx2 = (pBox->x2 - 1) / IMX_EPDC_PACE_TILE;
+	const int ty2 = (pBox->y2 - 1) / IMX_EPDC_PACE_TILE;
+
+	int tx, ty;
+	for (ty = ty1; (ty <= ty2) && (ty < fPtr->paceTilesY); ++ty) {
+
+		CARD32* pLastSent = fPtr->paceLastSent + ty * fPtr->paceTilesX;
+		for (tx = tx1; (tx <= tx2) && (tx < fPtr->paceTilesX); ++tx) {
+
+			pLastSent[tx] = now;
+		}
+	}
+}
+
+static CARD32
+imxEpdcPaceTimer(OsTimerPtr timer, CARD32 time, pointer arg)
+{
+	/* Nothing to do; waking up the server runs the BlockHandler */
+	/* which sends the updates that were held back. */
+	return 0;
+}
+
+/*
+ * (Re)create the pacing and ghosting tiles and the dithering buffer for
+ * the current screen size.  None is essential, so allocation failures
+ * only disable the feature.
+ */
+static void
+imxEpdcCreateTiles(ScrnInfoPtr pScrn, ImxEpdcPtr fPtr)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	free(fPtr->paceLastSent);
+	fPtr->paceLastSent = NULL;
+	fPtr->stats.updateRate = imxPtr->epdcUpdateRate;
+
+	/* Each tile starts out as if last updated a full interval ago */
+	if (imxPtr->epdcUpdateRate > 0) {
+
+		fPtr->paceInterval = 1000 / imxPtr->epdcUpdateRate;
+		fPtr->paceTilesX = IMX_ALIGN(pScrn->virtualX, IMX_EPDC_PACE_TILE) /
+					IMX_EPDC_PACE_TILE;
+		fPtr->paceTilesY = IMX_ALIGN(pScrn->virtualY, IMX_EPDC_PACE_TILE) /
+					IMX_EPDC_PACE_TILE;
+		fPtr->paceLastSent = malloc(sizeof(CARD32) *
+					fPtr->paceTilesX * fPtr->paceTilesY);
+		if (NULL == fPtr->paceLastSent) {
+
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				"unable to allocate EPDC pacing tiles\n");
+			fPtr->stats.updateRate = 0;
+
+		} else {
+
+			const CARD32 start = GetTimeInMillis() - fPtr->paceInterval;
+			int i;
+			for (i = 0; i < fPtr->paceTilesX * fPtr->paceTilesY; ++i) {
+				fPtr->paceLastSent[i] = start;
+			}
+		}
+	}
+
+	imxEpdcGhostDestroy(fPtr->pGhost);
+	fPtr->pGhost = NULL;
+
+	/* Ghosting is only accounted when the driver clears it up */
+	if (ImxEpdcRefreshOff != imxPtr->epdcFullRefresh) {
+
+		fPtr->pGhost = imxEpdcGhostCreate(pScrn->virtualX,
+						pScrn->virtualY,
+						imxPtr->epdcRefreshCount,
+						imxPtr->epdcRefreshArea);
+		if (NULL == fPtr->pGhost) {
+
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				"unable to allocate EPDC ghosting tiles\n");
+		}
+	}
+
+	free(fPtr->pGray);
+	fPtr->pGray = NULL;
+
+	/* Without it boxes are converted without dithering */
+	if (ImxEpdcDitherNone != imxPtr->epdcDither) {
+
+		fPtr->pGray = malloc(pScrn->virtualX * pScrn->virtualY);
+		if (NULL == fPtr->pGray) {
+
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				"unable to allocate EPDC dithering buffer\n");
+		}
+	}
+}
+
+/* Convert a box of the shadow to gray */
+static void
+imxEpdcConvertBox(ImxPtr imxPtr, unsigned char* pDst, unsigned char* pSrc,
+			int width, int height, int pitchDst, int pitchSrc)
+{
+	if (16 == imxPtr->epdcShadowBpp) {
+
+		imx_convert_sw_rgb565_to_y8(pDst, pSrc, width, height,
+			pitchDst, pitchSrc, imxPtr->epdcInverted);
+
+	} else {
+
+		imx_convert_sw_xrgb8888_to_y8(pDst, pSrc, width, height,
+			pitchDst, pitchSrc, imxPtr->epdcInverted);
+	}
+}
+
+/* Convert the damaged part of the shadow into the gray frame buffer */
+static void
+imxEpdcConvertShadow(ScrnInfoPtr pScrn, RegionPtr pRegion)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	const int shadowBytesPerPixel = imxPtr->epdcShadowBpp / 8;
+	const int shadowPitch = pScrn->displayWidth * shadowBytesPerPixel;
+	const int fbPitch = imxPtr->epdcFbPitch;
+
+	int nBox = REGION_NUM_RECTS(pRegion);
+	BoxPtr pBox = REGION_RECTS(pRegion);
+	for (; nBox > 0; --nBox, ++pBox) {
+
+		const int width = pBox->x2 - pBox->x1;
+		const int height = pBox->y2 - pBox->y1;
+
+		unsigned char* pSrc = imxPtr->epdcShadowMemory +
+			pBox->y1 * shadowPitch + pBox->x1 * shadowBytesPerPixel;
+		unsigned char* pDst = imxPtr->fbMemoryStart +
+			pBox->y1 * fbPitch + pBox->x1;
+
+		/* Dithering goes through system memory so the frame */
+		/* buffer is only ever written. */
+		unsigned char* pGray = fPtr->pGray;
+		if (NULL == pGray) {
+
+			imxEpdcConvertBox(imxPtr, pDst, pSrc, width, height,
+						fbPitch, shadowPitch);
+			continue;
+		}
+
+		imxEpdcConvertBox(imxPtr, pGray, pSrc, width, height,
+					width, shadowPitch);
+
+		if (ImxEpdcDitherOrdered == imxPtr->epdcDither) {
+
+			imx_dither_sw_ordered_8(pDst, pGray, width, height,
+				fbPitch, width, pBox->x1, pBox->y1,
+				imxPtr->epdcDitherLevels);
+
+		} else {
+
+			imx_dither_sw_diffuse_8(pDst, pGray, width, height,
+				fbPitch, width, imxPtr->epdcDitherLevels);
+		}
+	}
+}
+
+/* Does the box overlap an update the EPDC is still driving? */
+static Bool
+imxEpdcCollides(ImxEpdcPtr fPtr, const BoxRec* pBox)
+{
+	Bool collides = FALSE;
+
+	if (!fPtr->reaperRunning) {
+		return FALSE;
+	}
+
+	pthread_mutex_lock(&fPtr->mutex);
+
+	int i;
+	for (i = fPtr->inFlightReaped; i < fPtr->inFlightCount; ++i) {
+
+		const BoxRec* pInFlight =
+			&fPtr->inFlight[(fPtr->inFlightHead + i) %
+					IMX_EPDC_MAX_IN_FLIGHT].box;
+
+		if ((pBox->x1 < pInFlight->x2) && (pInFlight->x1 < pBox->x2) &&
+			(pBox->y1 < pInFlight->y2) && (pInFlight->y1 < pBox->y2)) {
+
+			collides = TRUE;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&fPtr->mutex);
+	return collides;
+}
+
+static CARD32
+imxEpdcRefreshTimer(OsTimerPtr timer, CARD32 time, pointer arg);
+
+/*
+ * Flashing refresh of the parts of the screen with ghosting.  Like any
+ * other update it waits for the updates it collides with and for the
+ * update rate; whatever is held back is marked stale again and retried.
+ */
+static void
+imxEpdcRefreshGhosting(ScrnInfoPtr pScrn)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	TimerCancel(fPtr->refreshTimer);
+
+	/* Stale tiles stay marked until the panel is ours again */
+	if ((NULL == fPtr->pGhost) || !pScrn->vtSema) {
+		return;
+	}
+
+	RegionRec staleRegion;
+	REGION_NULL(pScrn->pScreen, &staleRegion);
+
+	const long staleArea = imxEpdcGhostCollect(fPtr->pGhost, &staleRegion);
+	const long screenArea = (long)pScrn->virtualX * (long)pScrn->virtualY;
+
+	BoxRec updateBoxes[IMX_EPDC_MAX_UPDATES];
+	int nUpdates = 0;
+	Bool screenRefresh = FALSE;
+
+	if (0 == staleArea) {
+
+		/* nothing to do */
+
+	} else if ((ImxEpdcRefreshScreen == imxPtr->epdcFullRefresh) ||
+		(staleArea * 100 >= screenArea * IMX_EPDC_REFRESH_SCREEN_PERCENT)) {
+
+		/* One update is cheaper than many covering most of it */
+		updateBoxes[0].x1 = 0;
+		updateBoxes[0].y1 = 0;
+		updateBoxes[0].x2 = pScrn->virtualX;
+		updateBoxes[0].y2 = pScrn->virtualY;
+		nUpdates = 1;
+		screenRefresh = TRUE;
+
+	} else {
+
+		nUpdates =
+			imxEpdcRegionOptimize(
+				&staleRegion,
+				updateBoxes,
+				imxPtr->epdcMaxUpdates,
+				imxPtr->epdcMergeWaste,
+				IMX_EPDC_UPDATE_ALIGN_X,
+				IMX_EPDC_UPDATE_ALIGN_Y,
+				pScrn->virtualX,
+				pScrn->virtualY);
+	}
+
+	REGION_UNINIT(pScrn->pScreen, &staleRegion);
+
+	const CARD32 now = GetTimeInMillis();
+	int retryDelay = 0;
+	Bool sent = FALSE;
+
+	int i;
+	for (i = 0; i < nUpdates; ++i) {
+
+		BoxPtr pBox = &updateBoxes[i];
+		int delay;
+
+		if (imxEpdcCollides(fPtr, pBox)) {
+
+			++fPtr->stats.updatesPostponed;
+			delay = IMX_EPDC_REFRESH_RETRY;
+
+		} else {
+
+			delay = imxEpdcPaceDelay(fPtr, pBox, now);
+			if (delay > 0) {
+				++fPtr->stats.updatesPaced;
+			}
+		}
+
+		if (0 == delay) {
+
+			if (imxEpdcSendUpdate(pScrn, pBox, WAVEFORM_MODE_GC16,
+						UPDATE_MODE_FULL)) {
+
+				imxEpdcPaceMark(fPtr, pBox, now);
+				sent = TRUE;
+			}
+			continue;
+		}
+
+		imxEpdcGhostMarkStale(fPtr->pGhost, pBox);
+		if ((0 == retryDelay) || (delay < retryDelay)) {
+			retryDelay = delay;
+		}
+	}
+
+	if (sent) {
+
+		/* A flashing update of the whole panel leaves no ghosting */
+		if (screenRefresh) {
+			imxEpdcGhostReset(fPtr->pGhost);
+		}
+		++fPtr->stats.fullRefreshes;
+	}
+
+	if (retryDelay > 0) {
+
+		fPtr->refreshTimer = TimerSet(fPtr->refreshTimer, 0, retryDelay,
+					imxEpdcRefreshTimer, pScrn);
+	}
+}
+
+static CARD32
+imxEpdcRefreshTimer(OsTimerPtr timer, CARD32 time, pointer arg)
+{
+	imxEpdcRefreshGhosting((ScrnInfoPtr)arg);
+
+	/* Only rearmed by the next flush that leaves ghosting */
+	return 0;
+}
+
+static void
+imxEpdcScheduleRefresh(ScrnInfoPtr pScrn, ImxEpdcGhostState state)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	switch (state) {
+
+	case ImxEpdcGhostUrgent:
+		imxEpdcRefreshGhosting(pScrn);
+		break;
+
+	case ImxEpdcGhostStale:
+		/* Every flush pushes the refresh back, so it happens */
+		/* once the screen has been idle for the delay. */
+		fPtr->refreshTimer = TimerSet(fPtr->refreshTimer, 0,
+					imxPtr->epdcRefreshDelay,
+					imxEpdcRefreshTimer, pScrn);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/* Redraw the whole panel with one flashing update */
+static void
+imxEpdcRedrawScreen(ScrnInfoPtr pScrn)
+{
+	/* Access the screen. */
+	ScreenPtr pScreen = pScrn->pScreen;
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	fPtr->redrawScreen = FALSE;
+
+	BoxRec screenBox;
+	screenBox.x1 = 0;
+	screenBox.y1 = 0;
+	screenBox.x2 = pScrn->virtualX;
+	screenBox.y2 = pScrn->virtualY;
+
+	if (0 != imxPtr->epdcShadowBpp) {
+
+		RegionRec screenRegion;
+		REGION_INIT(pScreen, &screenRegion, &screenBox, 1);
+		imxEpdcConvertShadow(pScrn, &screenRegion);
+		REGION_UNINIT(pScreen, &screenRegion);
+	}
+
+	/* Everything pending is part of this update */
+	REGION_EMPTY(pScreen, &fPtr->postponedRegion);
+	DamageEmpty(fPtr->pDamage);
+
+	if (!imxEpdcSendUpdate(pScrn, &screenBox, WAVEFORM_MODE_GC16,
+				UPDATE_MODE_FULL)) {
+		return;
+	}
+
+	imxEpdcPaceMark(fPtr, &screenBox, GetTimeInMillis());
+
+	/* A flashing update of the whole panel leaves no ghosting */
+	TimerCancel(fPtr->refreshTimer);
+	if (NULL != fPtr->pGhost) {
+		imxEpdcGhostReset(fPtr->pGhost);
+	}
+}
+
+/*
+ * Send the screen damage to the EPDC.  Updates overlapping one still in
+ * flight are postponed until it completes, unless force is set, and
+ * whatever is drawn there meanwhile is folded into the same update.
+ */
+static void
+imxEpdcFlushDamage(ScrnInfoPtr pScrn, Bool force)
+{
+	/* Access the screen. */
+	ScreenPtr pScreen = pScrn->pScreen;
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	if (NULL == fPtr->pDamage) {
+		return;
+	}
+
+	RegionPtr pDamageRegion = DamageRegion(fPtr->pDamage);
+	if (!REGION_NOTEMPTY(pScreen, pDamageRegion) &&
+		!REGION_NOTEMPTY(pScreen, &fPtr->postponedRegion) &&
+		!fPtr->redrawScreen) {
+		return;
+	}
+
+	/* Leave the damage pending while another VT owns the panel */
+	if (!pScrn->vtSema) {
+		return;
+	}
+
+	if (fPtr->redrawScreen) {
+
+		imxEpdcRedrawScreen(pScrn);
+		return;
+	}
+
+	/* Only damaged pixels need converting, postponed ones were */
+	/* converted when they were damaged. */
+	if (0 != imxPtr->epdcShadowBpp) {
+		imxEpdcConvertShadow(pScrn, pDamageRegion);
+	}
+
+	/* Postponed updates are sent along with the new damage */
+	RegionRec pendingRegion;
+	REGION_NULL(pScreen, &pendingRegion);
+	REGION_UNION(pScreen, &pendingRegion, pDamageRegion,
+			&fPtr->postponedRegion);
+	REGION_EMPTY(pScreen, &fPtr->postponedRegion);
+	DamageEmpty(fPtr->pDamage);
+
+	/* Merge the damaged boxes into a few panel aligned updates */
+	BoxRec updateBoxes[IMX_EPDC_MAX_UPDATES];
+	const int nUpdates =
+		imxEpdcRegionOptimize(
+			&pendingRegion,
+			updateBoxes,
+			imxPtr->epdcMaxUpdates,
+			imxPtr->epdcMergeWaste,
+			IMX_EPDC_UPDATE_ALIGN_X,
+			IMX_EPDC_UPDATE_ALIGN_Y,
+			pScrn->virtualX,
+			pScrn->virtualY);
+
+	REGION_UNINIT(pScreen, &pendingRegion);
+
+	const CARD32 now = GetTimeInMillis();
+	const Bool fastPath = imxEpdcInputFastPath(imxPtr, now);
+	int paceDelay = 0;
+
+	ImxEpdcGhostState ghostState = ImxEpdcGhostClean;
+	int i;
+	for (i = 0; i < nUpdates; ++i) {
+
+		BoxPtr pBox = &updateBoxes[i];
+		Bool postpone = FALSE;
+
+		if (force) {
+
+			/* send it anyway */
+
+		} else if (imxEpdcCollides(fPtr, pBox)) {
+
+			++fPtr->stats.updatesPostponed;
+			postpone = TRUE;
+
+		} else {
+
+			/* Small updates following input are what the user */
+			/* is waiting to see, so they are never paced. */
+			const int delay = imxEpdcPaceDelay(fPtr, pBox, now);
+			const long area =
+				(long)(pBox->x2 - pBox->x1) *
+				(long)(pBox->y2 - pBox->y1);
+
+			if (0 == delay) {
+
+				/* within the rate */
+
+			} else if (fastPath && (area <= imxPtr->epdcSmallArea)) {
+
+				++fPtr->stats.updatesFastPath;
+
+			} else {
+
+				++fPtr->stats.updatesPaced;
+				if ((0 == paceDelay) || (delay < paceDelay)) {
+					paceDelay = delay;
+				}
+				postpone = TRUE;
+			}
+		}
+
+		if (postpone) {
+
+			RegionRec boxRegion;
+			REGION_INIT(pScreen, &boxRegion, pBox, 1);
+			REGION_UNION(pScreen, &fPtr->postponedRegion,
+					&fPtr->postponedRegion, &boxRegion);
+			REGION_UNINIT(pScreen, &boxRegion);
+			continue;
+		}
+
+		const int waveformMode = imxEpdcSelectWaveform(pScrn, pBox);
+
+		if (!imxEpdcSendUpdate(pScrn, pBox, waveformMode,
+					UPDATE_MODE_PARTIAL)) {
+			continue;
+		}
+
+		imxEpdcPaceMark(fPtr, pBox, now);
+
+		if (NULL != fPtr->pGhost) {
+
+			const ImxEpdcGhostState state =
+				imxEpdcGhostAccumulate(fPtr->pGhost, pBox);
+			if (state > ghostState) {
+				ghostState = state;
+			}
+		}
+	}
+
+	/* Paced updates only go out once the server wakes up again */
+	if (paceDelay > 0) {
+
+		fPtr->paceTimer = TimerSet(fPtr->paceTimer, 0, paceDelay,
+					imxEpdcPaceTimer, pScrn);
+	}
+
+	imxEpdcScheduleRefresh(pScrn, ghostState);
+}
+
+/* -------------------------------------------------------------------- */
+
+static Bool
+imxEpdcCreateScreenResources(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+	ImxPtr imxPtr = IMXPTR(pScrn);
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	pScreen->CreateScreenResources = fPtr->saveCreateScreenResources;
+	Bool ret = (*pScreen->CreateScreenResources)(pScreen);
+	pScreen->CreateScreenResources = imxEpdcCreateScreenResources;
+	if (!ret) {
+		return FALSE;
+	}
+
+	/* The screen pixmap only exists once resources are created */
+	PixmapPtr pScreenPixmap = (*pScreen->GetScreenPixmap)(pScreen);
+	if (NULL == pScreenPixmap) {
+		return FALSE;
+	}
+
+	fPtr->pDamage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+					pScreen, pScreen);
+	if (NULL == fPtr->pDamage) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+			"unable to create EPDC damage tracking\n");
+		return FALSE;
+	}
+
+	DamageRegister(&pScreenPixmap->drawable, fPtr->pDamage);
+	fPtr->pDamagePixmap = pScreenPixmap;
+
+	return TRUE;
+}
+
+static void
+imxEpdcBlockHandler(BLOCKHANDLER_ARGS_DECL)
+{
+	SCREEN_PTR(arg);
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+	ImxPtr imxPtr = IMXPTR(pScrn);
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	pScreen->BlockHandler = fPtr->saveBlockHandler;
+	(*pScreen->BlockHandler)(BLOCKHANDLER_ARGS);
+	pScreen->BlockHandler = imxEpdcBlockHandler;
+
+	/* Anything drawn by the wrapped block handlers (software */
+	/* cursor for one) is part of this flush. */
+	imxEpdcFlushDamage(pScrn, FALSE);
+}
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Send any pending damage to the EPDC and return the marker of the last
+ * update sent, which is the one to wait for to see everything drawn so
+ * far on the panel.  Returns 0 if pScreen has no EPDC update engine.
+ */
+CARD32
+imxEpdcFlushUpdates(ScreenPtr pScreen)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return 0;
+	}
+
+	/* The caller is going to wait, so nothing may be postponed */
+	imxEpdcFlushDamage(xf86ScreenToScrn(pScreen), TRUE);
+
+	/* Stays 0 until the first update is sent */
+	return fPtr->updateMarker;
+}
+
+/*
+ * Block until the update with the given marker has completed.  Only
+ * for callers that need the panel to be in a known state, everything
+ * else should use imxEpdcNotifyUpdate.
+ */
+void
+imxEpdcWaitForUpdate(ScreenPtr pScreen, CARD32 marker)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	marker = imxEpdcClampMarker(fPtr, marker);
+	if (0 == marker) {
+		return;
+	}
+
+	if (!fPtr->reaperRunning) {
+
+		__u32 waitMarker = marker;
+		ioctl(fPtr->fdDev, MXCFB_WAIT_FOR_UPDATE_COMPLETE, &waitMarker);
+		return;
+	}
+
+	pthread_mutex_lock(&fPtr->mutex);
+	while (!imxEpdcMarkerDone(fPtr->completedMarker, marker)) {
+
+		pthread_cond_wait(&fPtr->condComplete, &fPtr->mutex);
+	}
+	pthread_mutex_unlock(&fPtr->mutex);
+
+	imxEpdcRetireCompleted(fPtr);
+}
+
+/*
+ * The frame buffer was rotated and the screen resized to match it.  The
+ * EPDC driver takes update regions in the rotated frame buffer layout,
+ * which is the layout of the screen, so the damage needs no transform;
+ * only the per tile state has to follow the new screen size.  Callers
+ * flush and wait for the updates of the old orientation beforehand.
+ */
+void
+imxEpdcScreenRotated(ScreenPtr pScreen)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	/* Anything not sent yet was drawn for the old orientation */
+	REGION_EMPTY(pScreen, &fPtr->postponedRegion);
+	if (NULL != fPtr->pDamage) {
+		DamageEmpty(fPtr->pDamage);
+	}
+	TimerCancel(fPtr->paceTimer);
+	TimerCancel(fPtr->refreshTimer);
+
+	imxEpdcCreateTiles(xf86ScreenToScrn(pScreen), fPtr);
+
+	/* Every pixel on the panel moved */
+	fPtr->redrawScreen = TRUE;
+}
+
+/*
+ * Call notify from the server main loop once the update with the given
+ * marker has completed (right away if it already has).  Returns FALSE if
+ * pScreen has no EPDC update engine.
+ */
+Bool
+imxEpdcNotifyUpdate(ScreenPtr pScreen, CARD32 marker,
+			ImxEpdcNotifyProcPtr notify, pointer closure)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return FALSE;
+	}
+	marker = imxEpdcClampMarker(fPtr, marker);
+
+	/* Without the reaper there is no way to be told later */
+	if (!fPtr->reaperRunning) {
+
+		imxEpdcWaitForUpdate(pScreen, marker);
+		(*notify)(closure, marker);
+		return TRUE;
+	}
+
+	pthread_mutex_lock(&fPtr->mutex);
+	const Bool done = (0 == marker) ||
+		imxEpdcMarkerDone(fPtr->completedMarker, marker);
+	pthread_mutex_unlock(&fPtr->mutex);
+
+	if (done) {
+
+		(*notify)(closure, marker);
+		return TRUE;
+	}
+
+	ImxEpdcNotifyPtr pNotify = malloc(sizeof(ImxEpdcNotifyRec));
+	if (NULL == pNotify) {
+
+		imxEpdcWaitForUpdate(pScreen, marker);
+		(*notify)(closure, marker);
+		return TRUE;
+	}
+
+	pNotify->marker = marker;
+	pNotify->notify = notify;
+	pNotify->closure = closure;
+	pNotify->next = fPtr->notifyList;
+	fPtr->notifyList = pNotify;
+
+	return TRUE;
+}
+
+/*
+ * Forget a notification registered with imxEpdcNotifyUpdate that has
+ * not been called yet.
+ */
+void
+imxEpdcCancelNotifyUpdate(ScreenPtr pScreen, pointer closure)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	ImxEpdcNotifyPtr* ppNotify = &fPtr->notifyList;
+	while (NULL != *ppNotify) {
+
+		ImxEpdcNotifyPtr pNotify = *ppNotify;
+		if (pNotify->closure == closure) {
+
+			*ppNotify = pNotify->next;
+			free(pNotify);
+
+		} else {
+
+			ppNotify = &pNotify->next;
+		}
+	}
+}
+
+/*
+ * Copy the update counters of the screen.  Returns FALSE if pScreen has
+ * no EPDC update engine.
+ */
+Bool
+imxEpdcGetStats(ScreenPtr pScreen, ImxEpdcStatsPtr pStats)
+{
+	ImxEpdcPtr fPtr = imxEpdcGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return FALSE;
+	}
+
+	*pStats = fPtr->stats;
+
+	pthread_mutex_lock(&fPtr->mutex);
+	pStats->updatesInFlight = fPtr->inFlightCount - fPtr->inFlightReaped;
+	pthread_mutex_unlock(&fPtr->mutex);
+
+	return TRUE;
+}
+
+/* -------------------------------------------------------------------- */
+
+Bool
+imxEpdcScreenInit(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Private data structure must not already be in use. */
+	if (NULL != imxPtr->epdcPrivate) {
+		return FALSE;
+	}
+
+	/* Access the fd for the FB driver */
+	int fdDev = fbdevHWGetFD(pScrn);
+	if (-1 == fdDev) {
+		return FALSE;
+	}
+
+	/* The driver decides which regions get updated, so turn off */
+	/* any automatic updates made by the EPDC driver. */
+	__u32 autoUpdateMode = AUTO_UPDATE_MODE_REGION_MODE;
+	if (-1 == ioctl(fdDev, MXCFB_SET_AUTO_UPDATE_MODE, &autoUpdateMode)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"MXCFB_SET_AUTO_UPDATE_MODE: %s\n", strerror(errno));
+	}
+
+#ifdef MXCFB_SET_UPDATE_SCHEME
+	/* Let the EPDC driver merge updates still waiting in its queue */
+	__u32 updateScheme = UPDATE_SCHEME_QUEUE_AND_MERGE;
+	if (-1 == ioctl(fdDev, MXCFB_SET_UPDATE_SCHEME, &updateScheme)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"MXCFB_SET_UPDATE_SCHEME: %s\n", strerror(errno));
+	}
+#endif
+
+	/* The shadow is converted line by line into the frame buffer */
+	if (0 != imxPtr->epdcShadowBpp) {
+
+		struct fb_fix_screeninfo fbFixScreenInfo;
+		if (-1 == ioctl(fdDev, FBIOGET_FSCREENINFO, &fbFixScreenInfo)) {
+
+			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+				"FBIOGET_FSCREENINFO: %s\n", strerror(errno));
+			return FALSE;
+		}
+		imxPtr->epdcFbPitch = fbFixScreenInfo.line_length;
+	}
+
+	if (!DamageSetup(pScreen)) {
+		return FALSE;
+	}
+
+	/* Allocate memory for EPDC private data */
+	imxPtr->epdcPrivate = calloc(sizeof(ImxEpdcRec), 1);
+	if (NULL == imxPtr->epdcPrivate) {
+		return FALSE;
+	}
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+
+	fPtr->pDamage = NULL;
+	fPtr->pDamagePixmap = NULL;
+	fPtr->fdDev = fdDev;
+	fPtr->updateMarker = 0;
+	fPtr->completedMarker = 0;
+	fPtr->inFlightHead = 0;
+	fPtr->inFlightCount = 0;
+	fPtr->inFlightReaped = 0;
+	fPtr->notifyList = NULL;
+	fPtr->reaperRunning = FALSE;
+	fPtr->pGhost = NULL;
+	fPtr->refreshTimer = NULL;
+	fPtr->pGray = NULL;
+	REGION_NULL(pScreen, &fPtr->postponedRegion);
+	fPtr->paceLastSent = NULL;
+	fPtr->paceTimer = NULL;
+	fPtr->redrawScreen = FALSE;
+	memset(&fPtr->stats, 0, sizeof(fPtr->stats));
+
+	imxEpdcCreateTiles(pScrn, fPtr);
+
+	pthread_mutex_init(&fPtr->mutex, NULL);
+	pthread_cond_init(&fPtr->condSubmit, NULL);
+	pthread_cond_init(&fPtr->condComplete, NULL);
+
+	/* Without the reaper thread updates are still sent, but */
+	/* waiting for one blocks the server. */
+	if (!imxEpdcStartReaper(pScrn, fPtr)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"EPDC update completion will be synchronous\n");
+	}
+
+	/* Wrap the screen functions */
+	fPtr->saveCreateScreenResources = pScreen->CreateScreenResources;
+	pScreen->CreateScreenResources = imxEpdcCreateScreenResources;
+
+	fPtr->saveBlockHandler = pScreen->BlockHandler;
+	pScreen->BlockHandler = imxEpdcBlockHandler;
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO, "EPDC update engine enabled\n");
+
+	return TRUE;
+}
+
+void
+imxEpdcCloseScreen(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EPDC private screen data */
+	ImxEpdcPtr fPtr = IMXEPDCPTR(imxPtr);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	/* Unwrap the screen functions */
+	pScreen->CreateScreenResources = fPtr->saveCreateScreenResources;
+	pScreen->BlockHandler = fPtr->saveBlockHandler;
+
+	TimerFree(fPtr->refreshTimer);
+	imxEpdcGhostDestroy(fPtr->pGhost);
+	REGION_UNINIT(pScreen, &fPtr->postponedRegion);
+	TimerFree(fPtr->paceTimer);
+	free(fPtr->paceLastSent);
+	free(fPtr->pGray);
+
+	imxEpdcStopReaper(pScrn, fPtr);
+
+	pthread_cond_destroy(&fPtr->condComplete);
+	pthread_cond_destroy(&fPtr->condSubmit);
+	pthread_mutex_destroy(&fPtr->mutex);
+
+	if (NULL != fPtr->pDamage) {
+
+		IMX_DAMAGE_UNREGISTER(&fPtr->pDamagePixmap->drawable,
+					fPtr->pDamage);
+		DamageDestroy(fPtr->pDamage);
+	}
+
+	free(imxPtr->epdcPrivate);
+	imxPtr->epdcPrivate = NULL;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+#ifndef __IMX_EPDC_H__
+#define __IMX_EPDC_H__
+
+#include <linux/mxcfb.h>
+
+#include "xf86.h"
+
+/* Waveform modes missing from older mxcfb.h */
+#ifndef WAVEFORM_MODE_INIT
+#define	WAVEFORM_MODE_INIT		0x0
+#endif
+#ifndef WAVEFORM_MODE_DU
+#define	WAVEFORM_MODE_DU		0x1
+#endif
+#ifndef WAVEFORM_MODE_GC16
+#define	WAVEFORM_MODE_GC16		0x2
+#endif
+#ifndef WAVEFORM_MODE_GC4
+#define	WAVEFORM_MODE_GC4		0x3
+#endif
+#ifndef WAVEFORM_MODE_A2
+#define	WAVEFORM_MODE_A2		0x4
+#endif
+#ifndef WAVEFORM_MODE_AUTO
+#define	WAVEFORM_MODE_AUTO		257
+#endif
+
+/* -------------------------------------------------------------------- */
+
+/* Upper limit on the number of updates sent per flush */
+#define	IMX_EPDC_MAX_UPDATES		16
+
+/* Update rectangles are aligned to this many pixels */
+#define	IMX_EPDC_UPDATE_ALIGN_X		8
+#define	IMX_EPDC_UPDATE_ALIGN_Y		1
+
+/* Size of the tiles ghosting is accounted in */
+#define	IMX_EPDC_GHOST_TILE		64
+
+/* How the waveform for each update is chosen (WaveformEPDC option) */
+typedef enum {
+	ImxEpdcWaveformAuto,		/* from the pixels in the update */
+	ImxEpdcWaveformKernel,		/* left to the EPDC driver */
+	ImxEpdcWaveformDU,
+	ImxEpdcWaveformGC4,
+	ImxEpdcWaveformGC16
+} ImxEpdcWaveformSelect;
+
+/* How the shadow is dithered to the panel (DitherEPDC option) */
+typedef enum {
+	ImxEpdcDitherNone,
+	ImxEpdcDitherOrdered,		/* 8x8 Bayer matrix */
+	ImxEpdcDitherDiffusion		/* Floyd-Steinberg, per damaged box */
+} ImxEpdcDitherSelect;
+
+/* How ghosting is cleared up (FullRefreshEPDC option) */
+typedef enum {
+	ImxEpdcRefreshOff,		/* left to applications */
+	ImxEpdcRefreshRegion,		/* only where ghosting built up */
+	ImxEpdcRefreshScreen		/* always the whole screen */
+} ImxEpdcRefreshSelect;
+
+/* Ghosting accumulated on the screen */
+typedef enum {
+	ImxEpdcGhostClean,
+	ImxEpdcGhostStale,		/* refresh when idle */
+	ImxEpdcGhostUrgent		/* refresh right away */
+} ImxEpdcGhostState;
+
+typedef struct _ImxEpdcGhostRec ImxEpdcGhostRec, *ImxEpdcGhostPtr;
+
+/* Update counters since the screen was initialized */
+typedef struct {
+	CARD32		updateRate;		/* per second and tile, 0 unlimited */
+	CARD32		updatesInFlight;	/* sent and not yet completed */
+	CARD32		updatesSent;		/* including full refreshes */
+	CARD32		updatesPostponed;	/* held back for a collision */
+	CARD32		updatesPaced;		/* held back by the update rate */
+	CARD32		updatesFastPath;	/* let through after input */
+	CARD32		fullRefreshes;		/* to clear ghosting */
+} ImxEpdcStatsRec, *ImxEpdcStatsPtr;
+
+/* Called once the update with the given marker has completed */
+typedef void (*ImxEpdcNotifyProcPtr)(pointer closure, CARD32 marker);
+
+/* -------------------------------------------------------------------- */
+
+extern Bool
+imxEpdcScreenInit(ScreenPtr pScreen);
+
+extern void
+imxEpdcCloseScreen(ScreenPtr pScreen);
+
+extern CARD32
+imxEpdcFlushUpdates(ScreenPtr pScreen);
+
+extern void
+imxEpdcWaitForUpdate(ScreenPtr pScreen, CARD32 marker);
+
+extern Bool
+imxEpdcNotifyUpdate(ScreenPtr pScreen, CARD32 marker,
+			ImxEpdcNotifyProcPtr notify, pointer closure);
+
+extern void
+imxEpdcCancelNotifyUpdate(ScreenPtr pScreen, pointer closure);
+
+extern Bool
+imxEpdcGetStats(ScreenPtr pScreen, ImxEpdcStatsPtr pStats);
+
+extern void
+imxEpdcScreenRotated(ScreenPtr pScreen);
+
+extern int
+imxEpdcSelectWaveform(ScrnInfoPtr pScrn, const BoxRec* pBox);
+
+extern ImxEpdcGhostPtr
+imxEpdcGhostCreate(int width, int height, int countLimit, int areaPercent);
+
+extern void
+imxEpdcGhostDestroy(ImxEpdcGhostPtr pGhost);
+
+extern ImxEpdcGhostState
+imxEpdcGhostAccumulate(ImxEpdcGhostPtr pGhost, const BoxRec* pBox);
+
+extern long
+imxEpdcGhostCollect(ImxEpdcGhostPtr pGhost, RegionPtr pRegion);
+
+extern void
+imxEpdcGhostMarkStale(ImxEpdcGhostPtr pGhost, const BoxRec* pBox);
+
+extern void
+imxEpdcGhostReset(ImxEpdcGhostPtr pGhost);
+
+extern int
+imxEpdcRegionOptimize(RegionPtr pRegion, BoxPtr pBoxes, int maxBoxes,
+			int wastePercent, int alignX, int alignY,
+			int width, int height);
+
+#endif
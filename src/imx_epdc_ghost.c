@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * Ghosting accounting for EPDC updates.
+ *
+ * Partial updates leave a faint image of what was shown before, and the
+ * residue builds up with every partial update driven through the same
+ * pixels until a flashing (full mode) update clears it.  The screen is
+ * divided into tiles which count the partial updates touching them and
+ * the area those updates covered.  Once a tile passes either threshold
+ * it is stale and needs a flashing refresh; at twice the threshold the
+ * refresh should no longer wait for the screen to go idle.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "xf86.h"
+#include "regionstr.h"
+
+#include "imx.h"
+#include "imx_epdc.h"
+
+/* -------------------------------------------------------------------- */
+
+typedef struct {
+
+	/* Partial updates that touched the tile since its last refresh */
+	int		count;
+
+	/* Sum of the tile pixels those updates covered */
+	long		area;
+
+	Bool		stale;
+
+} ImxEpdcGhostTile;
+
+struct _ImxEpdcGhostRec {
+
+	/* Screen size in pixels and in tiles */
+	int			width;
+	int			height;
+	int			tilesX;
+	int			tilesY;
+
+	/* Thresholds; 0 disables the corresponding check */
+	int			countLimit;
+	int			areaPercent;
+
+	/* Number of tiles currently marked stale */
+	int			nStale;
+
+	ImxEpdcGhostTile*	tiles;
+};
+
+/* -------------------------------------------------------------------- */
+
+ImxEpdcGhostPtr
+imxEpdcGhostCreate(int width, int height, int countLimit, int areaPercent)
+{
+	ImxEpdcGhostPtr pGhost = calloc(sizeof(ImxEpdcGhostRec), 1);
+	if (NULL == pGhost) {
+		return NULL;
+	}
+
+	pGhost->width = width;
+	pGhost->height = height;
+	pGhost->tilesX = IMX_ALIGN(width, IMX_EPDC_GHOST_TILE) /
+				IMX_EPDC_GHOST_TILE;
+	pGhost->tilesY = IMX_ALIGN(height, IMX_EPDC_GHOST_TILE) /
+				IMX_EPDC_GHOST_TILE;
+	pGhost->countLimit = countLimit;
+	pGhost->areaPercent = areaPercent;
+	pGhost->nStale = 0;
+
+	pGhost->tiles = calloc(sizeof(ImxEpdcGhostTile),
+				pGhost->tilesX * pGhost->tilesY);
+	if (NULL == pGhost->tiles) {
+
+		free(pGhost);
+		return NULL;
+	}
+
+	return pGhost;
+}
+
+void
+imxEpdcGhostDestroy(ImxEpdcGhostPtr pGhost)
+{
+	if (NULL == pGhost) {
+		return;
+	}
+
+	free(pGhost->tiles);
+	free(pGhost);
+}
+
+/* Tile range covered by a box, clipped to the screen */
+static Bool
+imxEpdcGhostTileRange(ImxEpdcGhostPtr pGhost, const BoxRec* pBox,
+			int* pTx1, int* pTy1, int* pTx2, int* pTy2)
+{
+	const int x1 = (pBox->x1 > 0) ? pBox->x1 : 0;
+	const int y1 = (pBox->y1 > 0) ? pBox->y1 : 0;
+	const int x2 = (pBox->x2 < pGhost->width) ? pBox->x2 : pGhost->width;
+	const int y2 = (pBox->y2 < pGhost->height) ? pBox->y2 : pGhost->height;
+
+	if ((x1 >= x2) || (y1 >= y2)) {
+		return FALSE;
+	}
+
+	*pTx1 = x1 / IMX_EPDC_GHOST_TILE;
+	*pTy1 = y1 / IMX_EPDC_GHOST_TILE;
+	*pTx2 = (x2 - 1) / IMX_EPDC_GHOST_TILE + 1;
+	*pTy2 = (y2 - 1) / IMX_EPDC_GHOST_TILE + 1;
+
+	return TRUE;
+}
+
+/*
+ * Account for a partial update of the given box.  Returns the worst
+ * state of any tile on the screen afterwards.
+ */
+ImxEpdcGhostState
+imxEpdcGhostAccumulate(ImxEpdcGhostPtr pGhost, const BoxRec* pBox)
+{
+	ImxEpdcGhostState state =
+		(pGhost->nStale > 0) ? ImxEpdcGhostStale : ImxEpdcGhostClean;
+
+	int tx1, ty1, tx2, ty2;
+	if (!imxEpdcGhostTileRange(pGhost, pBox, &tx1, &ty1, &tx2, &ty2)) {
+		return state;
+	}
+
+	int ty, tx;
+	for (ty = ty1; ty < ty2; ++ty) {
+
+		const int tileY1 = ty * IMX_EPDC_GHOST_TILE;
+		const int tileY2 = (tileY1 + IMX_EPDC_GHOST_TILE < pGhost->height) ?
+			tileY1 + IMX_EPDC_GHOST_TILE : pGhost->height;
+		const int y1 = (pBox->y1 > tileY1) ? pBox->y1 : tileY1;
+		const int y2 = (pBox->y2 < tileY2) ? pBox->y2 : tileY2;
+
+		ImxEpdcGhostTile* pTile = pGhost->tiles + ty * pGhost->tilesX;
+		for (tx = tx1; tx < tx2; ++tx) {
+
+			const int tileX1 = tx * IMX_EPDC_GHOST_TILE;
+			const int tileX2 =
+				(tileX1 + IMX_EPDC_GHOST_TILE < pGhost->width) ?
+				tileX1 + IMX_EPDC_GHOST_TILE : pGhost->width;
+			const int x1 = (pBox->x1 > tileX1) ? pBox->x1 : tileX1;
+			const int x2 = (pBox->x2 < tileX2) ? pBox->x2 : tileX2;
+
+			ImxEpdcGhostTile* pT = &pTile[tx];
+			++pT->count;
+			pT->area += (long)(x2 - x1) * (long)(y2 - y1);
+
+			/* Percent of the tile area, with edge tiles */
+			/* being smaller than the others. */
+			const long tileArea =
+				(long)(tileX2 - tileX1) * (long)(tileY2 - tileY1);
+			const long areaPercent = pT->area * 100 / tileArea;
+
+			const Bool overCount = (pGhost->countLimit > 0) &&
+				(pT->count >= pGhost->countLimit);
+			const Bool overArea = (pGhost->areaPercent > 0) &&
+				(areaPercent >= pGhost->areaPercent);
+			if (!overCount && !overArea) {
+				continue;
+			}
+
+			if (!pT->stale) {
+				pT->stale = TRUE;
+				++pGhost->nStale;
+			}
+			if (ImxEpdcGhostClean == state) {
+				state = ImxEpdcGhostStale;
+			}
+
+			/* Far past the threshold the refresh cannot wait */
+			if (((pGhost->countLimit > 0) &&
+				(pT->count >= 2 * pGhost->countLimit)) ||
+				((pGhost->areaPercent > 0) &&
+				(areaPercent >= 2 * (long)pGhost->areaPercent))) {
+
+				state = ImxEpdcGhostUrgent;
+			}
+		}
+	}
+
+	return state;
+}
+
+/*
+ * Add the stale tiles to pRegion and forget them.  Returns the number
+ * of pixels added.
+ */
+long
+imxEpdcGhostCollect(ImxEpdcGhostPtr pGhost, RegionPtr pRegion)
+{
+	long staleArea = 0;
+
+	if (0 == pGhost->nStale) {
+		return 0;
+	}
+
+	int ty, tx;
+	for (ty = 0; ty < pGhost->tilesY; ++ty) {
+
+		ImxEpdcGhostTile* pTile = pGhost->tiles + ty * pGhost->tilesX;
+		for (tx = 0; tx < pGhost->tilesX; ++tx) {
+
+			if (!pTile[tx].stale) {
+				continue;
+			}
+
+			/* Add runs of stale tiles in one go */
+			const int txStart = tx;
+			while ((tx < pGhost->tilesX) && pTile[tx].stale) {
+
+				pTile[tx].count = 0;
+				pTile[tx].area = 0;
+				pTile[tx].stale = FALSE;
+				++tx;
+			}
+
+			BoxRec box;
+			box.x1 = txStart * IMX_EPDC_GHOST_TILE;
+			box.y1 = ty * IMX_EPDC_GHOST_TILE;
+			box.x2 = tx * IMX_EPDC_GHOST_TILE;
+			box.y2 = box.y1 + IMX_EPDC_GHOST_TILE;
+			if (box.x2 > pGhost->width) {
+				box.x2 = pGhost->width;
+			}
+			if (box.y2 > pGhost->height) {
+				box.y2 = pGhost->height;
+			}
+			staleArea += (long)(box.x2 - box.x1) *
+					(long)(box.y2 - box.y1);
+
+			RegionRec runRegion;
+			REGION_INIT(NULL, &runRegion, &box, 1);
+			REGION_UNION(NULL, pRegion, pRegion, &runRegion);
+			REGION_UNINIT(NULL, &runRegion);
+		}
+	}
+
+	pGhost->nStale = 0;
+	return staleArea;
+}
+
+/* Mark the tiles under a box stale again, for a refresh held back */
+void
+imxEpdcGhostMarkStale(ImxEpdcGhostPtr pGhost, const BoxRec* pBox)
+{
+	int tx1, ty1, tx2, ty2;
+	if (!imxEpdcGhostTileRange(pGhost, pBox, &tx1, &ty1, &tx2, &ty2)) {
+		return;
+	}
+
+	int ty, tx;
+	for (ty = ty1; ty < ty2; ++ty) {
+
+		ImxEpdcGhostTile* pTile = pGhost->tiles + ty * pGhost->tilesX;
+		for (tx = tx1; tx < tx2; ++tx) {
+
+			if (!pTile[tx].stale) {
+				pTile[tx].stale = TRUE;
+				++pGhost->nStale;
+			}
+		}
+	}
+}
+
+/* Forget all accumulated ghosting, after a full screen refresh */
+void
+imxEpdcGhostReset(ImxEpdcGhostPtr pGhost)
+{
+	memset(pGhost->tiles, 0,
+		sizeof(ImxEpdcGhostTile) * pGhost->tilesX * pGhost->tilesY);
+	pGhost->nStale = 0;
+}
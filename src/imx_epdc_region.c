@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * Region optimizer for EPDC updates.
+ *
+ * Every update sent to the EPDC costs a full waveform period on the part
+ * of the panel it covers, and the controller can only work on a limited
+ * number of updates at once.  Sending each damaged box separately floods
+ * the controller, while sending the bounding box of the damage refreshes
+ * large areas nothing was drawn in.  The damaged boxes are instead merged
+ * while the merged rectangle wastes no more than a configured share of
+ * its area on pixels that were not damaged.
+ *
+ * L-shaped damage arrives from the region code as separate y-x bands, so
+ * it stays split into a few rectangles unless merging it is cheap.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "xf86.h"
+#include "regionstr.h"
+
+#include "imx.h"
+#include "imx_epdc.h"
+
+/* -------------------------------------------------------------------- */
+
+typedef struct {
+
+	/* Rectangle to update, aligned for the panel */
+	BoxRec		box;
+
+	/* Number of damaged pixels the rectangle is covering */
+	long		damagedArea;
+
+} ImxEpdcRect;
+
+/* How many neighbours are searched when the pass that only merges */
+/* cheap pairs has not reduced the count far enough. */
+#define	IMX_EPDC_REGION_NEIGHBOURS	8
+
+static long
+imxEpdcBoxArea(const BoxRec* pBox)
+{
+	return (long)(pBox->x2 - pBox->x1) * (long)(pBox->y2 - pBox->y1);
+}
+
+static void
+imxEpdcBoxUnion(BoxPtr pDst, const BoxRec* pBox1, const BoxRec* pBox2)
+{
+	pDst->x1 = (pBox1->x1 < pBox2->x1) ? pBox1->x1 : pBox2->x1;
+	pDst->y1 = (pBox1->y1 < pBox2->y1) ? pBox1->y1 : pBox2->y1;
+	pDst->x2 = (pBox1->x2 > pBox2->x2) ? pBox1->x2 : pBox2->x2;
+	pDst->y2 = (pBox1->y2 > pBox2->y2) ? pBox1->y2 : pBox2->y2;
+}
+
+static void
+imxEpdcBoxAlign(BoxPtr pBox, int alignX, int alignY, int width, int height)
+{
+	pBox->x1 -= pBox->x1 % alignX;
+	pBox->y1 -= pBox->y1 % alignY;
+	pBox->x2 = IMX_ALIGN(pBox->x2, alignX);
+	pBox->y2 = IMX_ALIGN(pBox->y2, alignY);
+
+	if (pBox->x2 > width) {
+		pBox->x2 = width;
+	}
+	if (pBox->y2 > height) {
+		pBox->y2 = height;
+	}
+}
+
+/* Updates overlapping within one flush would collide on the panel */
+static Bool
+imxEpdcBoxIntersect(const BoxRec* pBox1, const BoxRec* pBox2)
+{
+	return (pBox1->x1 < pBox2->x2) && (pBox2->x1 < pBox1->x2) &&
+		(pBox1->y1 < pBox2->y2) && (pBox2->y1 < pBox1->y2);
+}
+
+/* Pixels a merge of the two rectangles would refresh for nothing */
+static long
+imxEpdcMergeWaste(const ImxEpdcRect* pRect1, const ImxEpdcRect* pRect2,
+			BoxPtr pMerged, long* pDamagedArea)
+{
+	imxEpdcBoxUnion(pMerged, &pRect1->box, &pRect2->box);
+
+	const long mergedArea = imxEpdcBoxArea(pMerged);
+
+	/* Aligned rectangles may overlap, so never count more damaged */
+	/* pixels than the merged rectangle holds. */
+	long damagedArea = pRect1->damagedArea + pRect2->damagedArea;
+	if (damagedArea > mergedArea) {
+		damagedArea = mergedArea;
+	}
+
+	*pDamagedArea = damagedArea;
+	return mergedArea - damagedArea;
+}
+
+static int
+imxEpdcMergeCheap(ImxEpdcRect* pRects, int nRects, int wastePercent)
+{
+	Bool merged;
+
+	do {
+		merged = FALSE;
+
+		int i;
+		for (i = 0; i < nRects; ++i) {
+
+			int j = i + 1;
+			while (j < nRects) {
+
+				BoxRec box;
+				long damagedArea;
+				const long waste =
+					imxEpdcMergeWaste(&pRects[i],
+						&pRects[j], &box, &damagedArea);
+
+				/* Keep separate if too much would be wasted, */
+				/* unless alignment made the two overlap */
+				if ((waste * 100 > damagedArea * wastePercent) &&
+					!imxEpdcBoxIntersect(&pRects[i].box,
+						&pRects[j].box)) {
+					++j;
+					continue;
+				}
+
+				pRects[i].box = box;
+				pRects[i].damagedArea = damagedArea;
+
+				/* Rectangle i grew, so check all again */
+				pRects[j] = pRects[--nRects];
+				j = i + 1;
+				merged = TRUE;
+			}
+		}
+
+	} while (merged);
+
+	return nRects;
+}
+
+static int
+imxEpdcMergeToLimit(ImxEpdcRect* pRects, int nRects, int maxRects)
+{
+	while (nRects > maxRects) {
+
+		int bestI = 0;
+		int bestJ = 1;
+		long bestWaste = -1;
+		BoxRec bestBox;
+		long bestDamagedArea = 0;
+
+		/* Rectangles come out of the region code roughly sorted */
+		/* by y, so only look a few entries ahead for a partner. */
+		int i;
+		for (i = 0; i < nRects - 1; ++i) {
+
+			int jEnd = i + 1 + IMX_EPDC_REGION_NEIGHBOURS;
+			if (jEnd > nRects) {
+				jEnd = nRects;
+			}
+
+			int j;
+			for (j = i + 1; j < jEnd; ++j) {
+
+				BoxRec box;
+				long damagedArea;
+				const long waste =
+					imxEpdcMergeWaste(&pRects[i],
+						&pRects[j], &box, &damagedArea);
+
+				if ((bestWaste < 0) || (waste < bestWaste)) {
+
+					bestI = i;
+					bestJ = j;
+					bestWaste = waste;
+					bestBox = box;
+					bestDamagedArea = damagedArea;
+				}
+			}
+		}
+
+		pRects[bestI].box = bestBox;
+		pRects[bestI].damagedArea = bestDamagedArea;
+
+		/* Keep the array order so neighbours stay neighbours */
+		memmove(&pRects[bestJ], &pRects[bestJ + 1],
+			(nRects - bestJ - 1) * sizeof(pRects[0]));
+		--nRects;
+	}
+
+	return nRects;
+}
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Reduce the boxes of pRegion to at most maxBoxes update rectangles
+ * stored in pBoxes.  Each rectangle is aligned to alignX/alignY pixels
+ * and clipped to width x height.  Returns the number of rectangles.
+ */
+int
+imxEpdcRegionOptimize(RegionPtr pRegion, BoxPtr pBoxes, int maxBoxes,
+			int wastePercent, int alignX, int alignY,
+			int width, int height)
+{
+	const int nBox = REGION_NUM_RECTS(pRegion);
+	BoxPtr pBox = REGION_RECTS(pRegion);
+
+	if ((nBox <= 0) || (maxBoxes <= 0)) {
+		return 0;
+	}
+
+	/* Nothing to decide for a single box */
+	if (1 == nBox) {
+
+		pBoxes[0] = *pBox;
+		imxEpdcBoxAlign(&pBoxes[0], alignX, alignY, width, height);
+		return 1;
+	}
+
+	ImxEpdcRect* pRects = malloc(nBox * sizeof(ImxEpdcRect));
+	if (NULL == pRects) {
+
+		/* Fall back to refreshing the whole damaged extent */
+		pBoxes[0] = *REGION_EXTENTS(NULL, pRegion);
+		imxEpdcBoxAlign(&pBoxes[0], alignX, alignY, width, height);
+		return 1;
+	}
+
+	/* Region boxes never overlap, so their areas are the damage. */
+	/* Boxes of consecutive bands with the same horizontal span */
+	/* are joined right away since that wastes nothing. */
+	int nRects = 0;
+	int i;
+	for (i = 0; i < nBox; ++i, ++pBox) {
+
+		ImxEpdcRect* pPrev = NULL;
+		int k;
+		for (k = nRects - 1;
+			(k >= 0) && (k >= nRects - IMX_EPDC_REGION_NEIGHBOURS);
+			--k) {
+
+			if ((pRects[k].box.x1 == pBox->x1) &&
+				(pRects[k].box.x2 == pBox->x2) &&
+				(pRects[k].box.y2 == pBox->y1)) {
+
+				pPrev = &pRects[k];
+				break;
+			}
+		}
+
+		if (NULL != pPrev) {
+
+			pPrev->box.y2 = pBox->y2;
+			pPrev->damagedArea += imxEpdcBoxArea(pBox);
+
+		} else {
+
+			pRects[nRects].box = *pBox;
+			pRects[nRects].damagedArea = imxEpdcBoxArea(pBox);
+			++nRects;
+		}
+	}
+
+	for (i = 0; i < nRects; ++i) {
+
+		imxEpdcBoxAlign(&pRects[i].box, alignX, alignY, width, height);
+	}
+
+	/* Merging to the limit can grow a rectangle over another one, */
+	/* so merge cheaply again to get rid of any new overlap. */
+	nRects = imxEpdcMergeCheap(pRects, nRects, wastePercent);
+	nRects = imxEpdcMergeToLimit(pRects, nRects, maxBoxes);
+	nRects = imxEpdcMergeCheap(pRects, nRects, wastePercent);
+
+	for (i = 0; i < nRects; ++i) {
+
+		pBoxes[i] = pRects[i].box;
+	}
+
+	free(pRects);
+	return nRects;
+}
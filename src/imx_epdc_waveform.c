@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * Waveform selection for EPDC updates.
+ *
+ * GC16 reproduces every gray level but flashes and takes the longest,
+ * DU is quick but only drives pixels to black or white, and GC4 sits in
+ * between with four levels.  The pixels of each update are scanned in
+ * the frame buffer and the update gets the fastest waveform that can
+ * still show them.  Small updates (typing, cursors) always get DU since
+ * latency matters more there than fidelity.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "xf86.h"
+
+#include "imx.h"
+#include "imx_epdc.h"
+
+/* -------------------------------------------------------------------- */
+
+/* Content classes, ordered by how demanding they are */
+#define	IMX_EPDC_CONTENT_MONO		0
+#define	IMX_EPDC_CONTENT_GRAY4		1
+#define	IMX_EPDC_CONTENT_GRAY16		2
+
+/* How far a gray level may be off one of the four GC4 levels */
+#define	IMX_EPDC_LEVEL_TOLERANCE	8
+
+/* Content class of each 8-bit gray level */
+static CARD8 imxEpdcLevelClass[256];
+static Bool imxEpdcLevelClassReady = FALSE;
+
+static void
+imxEpdcInitLevelClass(void)
+{
+	int level;
+	for (level = 0; level < 256; ++level) {
+
+		/* Nearest of 0x00, 0x55, 0xAA and 0xFF */
+		const int nearest = ((level + 42) / 85) * 85;
+		const int distance =
+			(level > nearest) ? (level - nearest) : (nearest - level);
+
+		if (distance > IMX_EPDC_LEVEL_TOLERANCE) {
+			imxEpdcLevelClass[level] = IMX_EPDC_CONTENT_GRAY16;
+		} else if ((0 == nearest) || (255 == nearest)) {
+			imxEpdcLevelClass[level] = IMX_EPDC_CONTENT_MONO;
+		} else {
+			imxEpdcLevelClass[level] = IMX_EPDC_CONTENT_GRAY4;
+		}
+	}
+
+	imxEpdcLevelClassReady = TRUE;
+}
+
+/* Luma weights sum to 256 so white stays 0xFF */
+#define	IMX_EPDC_LUMA(r, g, b)	(((r) * 77 + (g) * 150 + (b) * 29) >> 8)
+
+/* -------------------------------------------------------------------- */
+
+static int
+imxEpdcClassify8(const CARD8* pRow, int pitch, int width, int height)
+{
+	int content = IMX_EPDC_CONTENT_MONO;
+
+	while (height-- > 0) {
+
+		const CARD8* p = pRow;
+		const CARD8* pEnd = pRow + width;
+
+		/* Leading bytes up to word alignment */
+		while ((p < pEnd) && (0 != ((unsigned long)p & 3))) {
+			const int c = imxEpdcLevelClass[*p++];
+			if (c > content) {
+				content = c;
+			}
+		}
+
+		/* Whole words; solid black or white is the common case */
+		while (p + 4 <= pEnd) {
+			const CARD32 word = *(const CARD32*)p;
+			if ((0 != word) && (0xFFFFFFFF != word)) {
+				int c = imxEpdcLevelClass[p[0]];
+				if (imxEpdcLevelClass[p[1]] > c) {
+					c = imxEpdcLevelClass[p[1]];
+				}
+				if (imxEpdcLevelClass[p[2]] > c) {
+					c = imxEpdcLevelClass[p[2]];
+				}
+				if (imxEpdcLevelClass[p[3]] > c) {
+					c = imxEpdcLevelClass[p[3]];
+				}
+				if (c > content) {
+					content = c;
+				}
+			}
+			p += 4;
+		}
+
+		/* Trailing bytes */
+		while (p < pEnd) {
+			const int c = imxEpdcLevelClass[*p++];
+			if (c > content) {
+				content = c;
+			}
+		}
+
+		/* Nothing can raise the class any further */
+		if (IMX_EPDC_CONTENT_GRAY16 == content) {
+			break;
+		}
+
+		pRow += pitch;
+	}
+
+	return content;
+}
+
+static int
+imxEpdcClassify16(const CARD8* pRow, int pitch, int width, int height)
+{
+	int content = IMX_EPDC_CONTENT_MONO;
+
+	while (height-- > 0) {
+
+		const CARD16* p = (const CARD16*)pRow;
+		int x;
+		for (x = 0; x < width; ++x) {
+
+			const CARD16 pixel = p[x];
+			if ((0x0000 == pixel) || (0xFFFF == pixel)) {
+				continue;
+			}
+
+			/* Expand RGB565 to 8 bits per channel */
+			const int r = (pixel >> 11) & 0x1F;
+			const int g = (pixel >> 5) & 0x3F;
+			const int b = pixel & 0x1F;
+			const int level = IMX_EPDC_LUMA(
+				(r << 3) | (r >> 2),
+				(g << 2) | (g >> 4),
+				(b << 3) | (b >> 2));
+
+			const int c = imxEpdcLevelClass[level];
+			if (c > content) {
+				content = c;
+			}
+		}
+
+		if (IMX_EPDC_CONTENT_GRAY16 == content) {
+			break;
+		}
+
+		pRow += pitch;
+	}
+
+	return content;
+}
+
+static int
+imxEpdcClassify32(const CARD8* pRow, int pitch, int width, int height)
+{
+	int content = IMX_EPDC_CONTENT_MONO;
+
+	while (height-- > 0) {
+
+		const CARD32* p = (const CARD32*)pRow;
+		int x;
+		for (x = 0; x < width; ++x) {
+
+			const CARD32 pixel = p[x] & 0x00FFFFFF;
+			if ((0x000000 == pixel) || (0xFFFFFF == pixel)) {
+				continue;
+			}
+
+			const int level = IMX_EPDC_LUMA(
+				(pixel >> 16) & 0xFF,
+				(pixel >> 8) & 0xFF,
+				pixel & 0xFF);
+
+			const int c = imxEpdcLevelClass[level];
+			if (c > content) {
+				content = c;
+			}
+		}
+
+		if (IMX_EPDC_CONTENT_GRAY16 == content) {
+			break;
+		}
+
+		pRow += pitch;
+	}
+
+	return content;
+}
+
+/* -------------------------------------------------------------------- */
+
+/* Inverted Y8 only swaps black and white, which does not change the */
+/* class of any pixel, so it needs no special handling. */
+static int
+imxEpdcClassifyBox(ScrnInfoPtr pScrn, const BoxRec* pBox)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	if (!imxEpdcLevelClassReady) {
+		imxEpdcInitLevelClass();
+	}
+
+	/* Look at what the panel is going to show, which is the gray */
+	/* frame buffer rather than the shadow X renders into. */
+	int bitsPerPixel = pScrn->bitsPerPixel;
+	int pitch = pScrn->displayWidth * (bitsPerPixel / 8);
+	if (0 != imxPtr->epdcShadowBpp) {
+		bitsPerPixel = 8;
+		pitch = imxPtr->epdcFbPitch;
+	}
+
+	const int bytesPerPixel = bitsPerPixel / 8;
+	const int width = pBox->x2 - pBox->x1;
+	const int height = pBox->y2 - pBox->y1;
+	const CARD8* pRow = imxPtr->fbMemoryStart +
+		pBox->y1 * pitch + pBox->x1 * bytesPerPixel;
+
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imxEpdcClassify8(pRow, pitch, width, height);
+
+	case 16:
+		return imxEpdcClassify16(pRow, pitch, width, height);
+
+	case 32:
+		return imxEpdcClassify32(pRow, pitch, width, height);
+
+	default:
+		return IMX_EPDC_CONTENT_GRAY16;
+	}
+}
+
+/* Waveform mode to send with an update of the given box */
+int
+imxEpdcSelectWaveform(ScrnInfoPtr pScrn, const BoxRec* pBox)
+{
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	switch (imxPtr->epdcWaveform) {
+
+	case ImxEpdcWaveformKernel:
+		return WAVEFORM_MODE_AUTO;
+
+	case ImxEpdcWaveformDU:
+		return WAVEFORM_MODE_DU;
+
+	case ImxEpdcWaveformGC4:
+		return WAVEFORM_MODE_GC4;
+
+	case ImxEpdcWaveformGC16:
+		return WAVEFORM_MODE_GC16;
+
+	default:
+		break;
+	}
+
+	const long area =
+		(long)(pBox->x2 - pBox->x1) * (long)(pBox->y2 - pBox->y1);
+	if (area <= imxPtr->epdcSmallArea) {
+		return WAVEFORM_MODE_DU;
+	}
+
+	switch (imxEpdcClassifyBox(pScrn, pBox)) {
+
+	case IMX_EPDC_CONTENT_MONO:
+		return WAVEFORM_MODE_DU;
+
+	case IMX_EPDC_CONTENT_GRAY4:
+		return WAVEFORM_MODE_GC4;
+
+	default:
+		return WAVEFORM_MODE_GC16;
+	}
+}
@@ -0,0 +1,2166 @@
+/*
+ * Copyright (C) 2011 Freescale Semiconductor, Inc.  All Rights Reserved.
+ * 
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without 
+ * restriction, including without limitation the rights to use, copy, 
+ * modify, merge, publish, distribute, sublicense, and/or sell copies 
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS 
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN 
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+ */
+
+/*
+ * Software EXA driver.
+ *
+ * The i.MX cores have no 2D engine this driver can use, so the EXA hooks
+ * run the CPU kernels from imx_accel.c instead.  Compared with the generic
+ * fb code they move whole rows with NEON loads and stores rather than
+ * going through the raster op machinery a pixel at a time.
+ *
+ * The driver allocates the pixmaps itself (EXA_HANDLES_PIXMAPS).  Pixmaps
+ * live in the frame buffer memory beyond the screen, managed by the
+ * allocator in imx_exa_offscreen.c, and in system memory once that is
+ * used up.  The CPU can reach both, so every pixmap with pixels counts as
+ * offscreen to EXA and no migration is ever needed.  An evicted pixmap is
+ * copied to system memory and stays there.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "xf86.h"
+#include "fbdevhw.h"
+#include "damage.h"
+
+#include "imx.h"
+#include "imx_accel.h"
+#include "imx_exa.h"
+
+#include "compat-api.h"
+
+#if (IMX_EXA_VERSION_COMPILED >= IMX_EXA_VERSION(2,5,0))
+
+/* Byte alignment of pixmap rows and offscreen memory, one cache line */
+#define	IMX_EXA_PIXMAP_ALIGN		32
+
+/* Largest pixmap EXA hands to the driver */
+#define	IMX_EXA_MAX_WIDTH		4096
+#define	IMX_EXA_MAX_HEIGHT		4096
+
+/* Uploads of up to this many bytes to frame buffer pixmaps are batched */
+#define	IMX_EXA_UPLOAD_BATCH_SMALL	1024
+
+/* Milliseconds of offscreen compaction each time the server goes idle */
+#define	IMX_EXA_COMPACT_TIME		2
+
+/* -------------------------------------------------------------------- */
+
+static ImxExaPtr
+imxExaGetScreenPrivate(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	return IMXEXAPTR(imxPtr);
+}
+
+static ImxExaPixmapPtr
+imxExaGetPixmapPrivate(PixmapPtr pPixmap)
+{
+	return (ImxExaPixmapPtr)exaGetPixmapDriverPrivate(pPixmap);
+}
+
+static imx_copy_sw_no_overlap_func
+imxExaGetCopyFunc(int bitsPerPixel)
+{
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imx_copy_sw_no_overlap_8;
+
+	case 16:
+		return imx_copy_sw_no_overlap_16;
+
+	case 32:
+		return imx_copy_sw_no_overlap_32;
+
+	default:
+		return NULL;
+	}
+}
+
+static imx_copy_sw_overlap_func
+imxExaGetCopyOverlapFunc(int bitsPerPixel)
+{
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imx_copy_sw_overlap_8;
+
+	case 16:
+		return imx_copy_sw_overlap_16;
+
+	case 32:
+		return imx_copy_sw_overlap_32;
+
+	default:
+		return NULL;
+	}
+}
+
+static imx_fill_sw_func
+imxExaGetFillFunc(int bitsPerPixel)
+{
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imx_fill_sw_8;
+
+	case 16:
+		return imx_fill_sw_16;
+
+	case 32:
+		return imx_fill_sw_32;
+
+	default:
+		return NULL;
+	}
+}
+
+static imx_copy_sw_no_overlap_func
+imxExaGetUploadFunc(int bitsPerPixel)
+{
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imx_upload_sw_8;
+
+	case 16:
+		return imx_upload_sw_16;
+
+	case 32:
+		return imx_upload_sw_32;
+
+	default:
+		return NULL;
+	}
+}
+
+static imx_copy_sw_no_overlap_func
+imxExaGetDownloadFunc(int bitsPerPixel)
+{
+	switch (bitsPerPixel) {
+
+	case 8:
+		return imx_download_sw_8;
+
+	case 16:
+		return imx_download_sw_16;
+
+	case 32:
+		return imx_download_sw_32;
+
+	default:
+		return NULL;
+	}
+}
+
+/* Address of pixel (x, y) of the pixmap */
+static unsigned char*
+imxExaPixelAddress(ImxExaPixmapPtr fPixmapPtr, int x, int y)
+{
+	return fPixmapPtr->ptr + y * fPixmapPtr->pitchBytes +
+		x * (fPixmapPtr->bitsPerPixel >> 3);
+}
+
+/* Tell the eviction policy, which keeps pixmaps in use the longest */
+static void
+imxExaMarkUsed(ImxExaPtr fPtr, ImxExaPixmapPtr fPixmapPtr)
+{
+	if (NULL != fPixmapPtr->pArea) {
+
+		imxExaOffscreenMarkUsed(fPtr, fPixmapPtr->pArea);
+
+	} else if (fPixmapPtr->evicted) {
+
+		fPtr->offScreenMisses++;
+	}
+}
+
+/* Write the batched uploads to their pixmaps, oldest first.  Called */
+/* before anything else can read or move pixmap memory. */
+static void
+imxExaFlushUploads(ImxExaPtr fPtr)
+{
+	int i;
+
+	if ((NULL == fPtr) || (0 == fPtr->numUploads)) {
+		return;
+	}
+
+	for (i = 0; i < fPtr->numUploads; ++i) {
+
+		ImxExaUploadPtr pUpload = &fPtr->uploads[i];
+		ImxExaPixmapPtr fPixmapPtr = pUpload->fPixmapPtr;
+
+		/* Pixmap may have been evicted since; write wherever */
+		/* its pixels are now. */
+		if (NULL == fPixmapPtr->ptr) {
+			continue;
+		}
+
+		imx_copy_sw_no_overlap_func uploadFunc =
+			imxExaGetUploadFunc(fPixmapPtr->bitsPerPixel);
+
+		(*uploadFunc)(
+			imxExaPixelAddress(fPixmapPtr, pUpload->x, pUpload->y),
+			fPtr->uploadBuffer + pUpload->offset,
+			pUpload->width,
+			pUpload->height,
+			fPixmapPtr->pitchBytes,
+			pUpload->pitch);
+	}
+
+	fPtr->numUploads = 0;
+	fPtr->uploadBufferUsed = 0;
+}
+
+/* Release the pixel memory owned by the pixmap */
+static void
+imxExaFreePixmapMemory(ScreenPtr pScreen, ImxExaPixmapPtr fPixmapPtr)
+{
+	if (NULL != fPixmapPtr->pArea) {
+
+		imxExaOffscreenFree(pScreen, fPixmapPtr->pArea);
+		fPixmapPtr->pArea = NULL;
+	}
+
+	free(fPixmapPtr->pSysMem);
+	fPixmapPtr->pSysMem = NULL;
+
+	fPixmapPtr->ptr = NULL;
+}
+
+/* -------------------------------------------------------------------- */
+
+/* Offscreen area of the pixmap is about to be given to another one */
+static void
+imxExaPixmapSave(ScreenPtr pScreen, ExaOffscreenArea* pArea)
+{
+	ImxExaPixmapPtr fPixmapPtr = (ImxExaPixmapPtr)pArea->privData;
+
+	imxExaFlushUploads(imxExaGetScreenPrivate(pScreen));
+
+	const int size = fPixmapPtr->pitchBytes * fPixmapPtr->height;
+	unsigned char* pSysMem = malloc(size);
+	if (NULL == pSysMem) {
+
+		/* Without a copy the pixels stay where they are, and */
+		/* the allocation wanting the space fails instead. */
+		xf86DrvMsg(xf86ScreenToScrn(pScreen)->scrnIndex, X_WARNING,
+			"unable to save evicted pixmap (%d bytes)\n", size);
+		imxExaOffscreenSaveFailed(pArea);
+		return;
+	}
+
+	fPixmapPtr->evicted = TRUE;
+
+	/* Frame buffer memory is read through the download kernels; */
+	/* depths without one are read as whole rows of bytes */
+	imx_copy_sw_no_overlap_func downloadFunc =
+		imxExaGetDownloadFunc(fPixmapPtr->bitsPerPixel);
+	int width = fPixmapPtr->width;
+	if (NULL == downloadFunc) {
+		downloadFunc = imx_download_sw_8;
+		width = fPixmapPtr->pitchBytes;
+	}
+
+	(*downloadFunc)(
+		pSysMem,
+		fPixmapPtr->ptr,
+		width,
+		fPixmapPtr->height,
+		fPixmapPtr->pitchBytes,
+		fPixmapPtr->pitchBytes);
+
+	fPixmapPtr->pArea = NULL;
+	fPixmapPtr->pSysMem = pSysMem;
+	fPixmapPtr->ptr = pSysMem;
+}
+
+/* Offscreen area has been moved by compaction.  The glyph atlas is */
+/* found through its area each time, so only pixmaps need updating. */
+static void
+imxExaAreaMoved(ScreenPtr pScreen, ExaOffscreenArea* pArea)
+{
+	if (imxExaPixmapSave == pArea->save) {
+
+		ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+		ImxExaPixmapPtr fPixmapPtr = (ImxExaPixmapPtr)pArea->privData;
+
+		fPixmapPtr->ptr = (unsigned char*)fPtr->exaDriverPtr->memoryBase +
+					pArea->offset;
+	}
+}
+
+/* Server is about to sleep; use a little of the time to compact */
+/* offscreen memory once fragmentation has cost an eviction. */
+static void
+imxExaBlockHandler(BLOCKHANDLER_ARGS_DECL)
+{
+	SCREEN_PTR(arg);
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+
+	pScreen->BlockHandler = fPtr->saveBlockHandler;
+	(*pScreen->BlockHandler)(BLOCKHANDLER_ARGS);
+	pScreen->BlockHandler = imxExaBlockHandler;
+
+	if (fPtr->offScreenFragmented) {
+
+		imxExaFlushUploads(fPtr);
+		fPtr->offScreenFragmented = imxExaOffscreenCompact(pScreen,
+					imxExaAreaMoved,
+					GetTimeInMillis() + IMX_EXA_COMPACT_TIME);
+	}
+}
+
+static void*
+imxExaCreatePixmap2(ScreenPtr pScreen, int width, int height, int depth,
+			int usage_hint, int bitsPerPixel, int* pNewPitch)
+{
+	ImxExaPixmapPtr fPixmapPtr = calloc(sizeof(ImxExaPixmapRec), 1);
+	if (NULL == fPixmapPtr) {
+		return NULL;
+	}
+
+	fPixmapPtr->width = width;
+	fPixmapPtr->height = height;
+	fPixmapPtr->bitsPerPixel = bitsPerPixel;
+
+	/* Headers for memory set up by ModifyPixmapHeader come with */
+	/* no size. */
+	if ((width <= 0) || (height <= 0) || (bitsPerPixel <= 0)) {
+		return fPixmapPtr;
+	}
+
+	const int pitchBytes =
+		IMX_ALIGN((width * bitsPerPixel + 7) / 8, IMX_EXA_PIXMAP_ALIGN);
+	const int size = pitchBytes * height;
+
+	/* Frame buffer memory first, then system memory */
+	fPixmapPtr->pArea = imxExaOffscreenAlloc(pScreen, size,
+					IMX_EXA_PIXMAP_ALIGN, FALSE,
+					imxExaPixmapSave, fPixmapPtr);
+	if (NULL != fPixmapPtr->pArea) {
+
+		ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+		fPixmapPtr->ptr = (unsigned char*)fPtr->exaDriverPtr->memoryBase +
+					fPixmapPtr->pArea->offset;
+
+	} else {
+
+		fPixmapPtr->pSysMem = malloc(size);
+		if (NULL == fPixmapPtr->pSysMem) {
+
+			free(fPixmapPtr);
+			return NULL;
+		}
+		fPixmapPtr->ptr = fPixmapPtr->pSysMem;
+	}
+
+	fPixmapPtr->pitchBytes = pitchBytes;
+	*pNewPitch = pitchBytes;
+
+	return fPixmapPtr;
+}
+
+static void
+imxExaDestroyPixmap(ScreenPtr pScreen, void* driverPriv)
+{
+	ImxExaPixmapPtr fPixmapPtr = (ImxExaPixmapPtr)driverPriv;
+	if (NULL == fPixmapPtr) {
+		return;
+	}
+
+	imxExaFlushUploads(imxExaGetScreenPrivate(pScreen));
+	imxExaFreePixmapMemory(pScreen, fPixmapPtr);
+	free(fPixmapPtr);
+}
+
+static Bool
+imxExaModifyPixmapHeader(PixmapPtr pPixmap, int width, int height,
+			int depth, int bitsPerPixel, int devKind,
+			pointer pPixData)
+{
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+	if (NULL == fPixmapPtr) {
+		return FALSE;
+	}
+
+	/* Pixels provided by the caller, such as the screen */
+	if (NULL != pPixData) {
+
+		imxExaFlushUploads(
+			imxExaGetScreenPrivate(pPixmap->drawable.pScreen));
+		imxExaFreePixmapMemory(pPixmap->drawable.pScreen, fPixmapPtr);
+		fPixmapPtr->ptr = (unsigned char*)pPixData;
+	}
+
+	if (width > 0) {
+		fPixmapPtr->width = width;
+	}
+	if (height > 0) {
+		fPixmapPtr->height = height;
+	}
+	if (bitsPerPixel > 0) {
+		fPixmapPtr->bitsPerPixel = bitsPerPixel;
+	}
+	if (devKind > 0) {
+		fPixmapPtr->pitchBytes = devKind;
+	}
+
+	/* Let the screen update the rest of the pixmap header */
+	return FALSE;
+}
+
+static Bool
+imxExaPixmapIsOffscreen(PixmapPtr pPixmap)
+{
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+
+	return (NULL != fPixmapPtr) && (NULL != fPixmapPtr->ptr);
+}
+
+static Bool
+imxExaPrepareAccess(PixmapPtr pPixmap, int index)
+{
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+	if ((NULL == fPixmapPtr) || (NULL == fPixmapPtr->ptr)) {
+		return FALSE;
+	}
+
+	imxExaFlushUploads(imxExaGetScreenPrivate(pPixmap->drawable.pScreen));
+
+	/* Pixels being accessed must not be evicted under the caller */
+	if ((0 == fPixmapPtr->accessCount++) && (NULL != fPixmapPtr->pArea)) {
+
+		imxExaMarkUsed(imxExaGetScreenPrivate(pPixmap->drawable.pScreen),
+				fPixmapPtr);
+		fPixmapPtr->pArea->state = ExaOffscreenLocked;
+	}
+
+	pPixmap->devPrivate.ptr = fPixmapPtr->ptr;
+
+	return TRUE;
+}
+
+static void
+imxExaFinishAccess(PixmapPtr pPixmap, int index)
+{
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+	if ((NULL == fPixmapPtr) || (fPixmapPtr->accessCount <= 0)) {
+		return;
+	}
+
+	if ((0 == --fPixmapPtr->accessCount) && (NULL != fPixmapPtr->pArea)) {
+
+		fPixmapPtr->pArea->state = ExaOffscreenRemovable;
+	}
+}
+
+/* -------------------------------------------------------------------- */
+
+static void
+imxExaWaitMarker(ScreenPtr pScreen, int marker)
+{
+	/* Every operation completes before it returns; only batched */
+	/* uploads can still be outstanding. */
+	imxExaFlushUploads(imxExaGetScreenPrivate(pScreen));
+}
+
+static Bool
+imxExaPrepareSolid(PixmapPtr pPixmap, int alu, Pixel planemask, Pixel fg)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmap->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+
+	imxExaFlushUploads(fPtr);
+
+	if ((NULL == fPixmapPtr) || (NULL == fPixmapPtr->ptr)) {
+		return FALSE;
+	}
+
+	/* Only plain fills have kernels */
+	if ((GXcopy != alu) ||
+		!EXA_PM_IS_SOLID(&pPixmap->drawable, planemask)) {
+		return FALSE;
+	}
+
+	fPtr->solidFunc = imxExaGetFillFunc(pPixmap->drawable.bitsPerPixel);
+	if (NULL == fPtr->solidFunc) {
+		return FALSE;
+	}
+	fPtr->solidColor = fg;
+
+	imxExaMarkUsed(fPtr, fPixmapPtr);
+
+	return TRUE;
+}
+
+static void
+imxExaSolid(PixmapPtr pPixmap, int x1, int y1, int x2, int y2)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmap->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+
+	imx_accel_pool_fill(
+		fPtr->pool,
+		fPtr->solidFunc,
+		imxExaPixelAddress(fPixmapPtr, x1, y1),
+		x2 - x1,
+		y2 - y1,
+		fPixmapPtr->pitchBytes,
+		fPtr->solidColor);
+}
+
+static void
+imxExaDoneSolid(PixmapPtr pPixmap)
+{
+	/* Nothing to do */
+}
+
+static Bool
+imxExaPrepareCopy(PixmapPtr pPixmapSrc, PixmapPtr pPixmapDst,
+			int xdir, int ydir, int alu, Pixel planemask)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmapDst->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapSrcPtr = imxExaGetPixmapPrivate(pPixmapSrc);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pPixmapDst);
+
+	imxExaFlushUploads(fPtr);
+
+	if ((NULL == fPixmapSrcPtr) || (NULL == fPixmapSrcPtr->ptr) ||
+		(NULL == fPixmapDstPtr) || (NULL == fPixmapDstPtr->ptr)) {
+		return FALSE;
+	}
+
+	/* Only plain copies between pixmaps of the same format */
+	if ((GXcopy != alu) ||
+		!EXA_PM_IS_SOLID(&pPixmapDst->drawable, planemask) ||
+		(pPixmapSrc->drawable.bitsPerPixel !=
+			pPixmapDst->drawable.bitsPerPixel)) {
+		return FALSE;
+	}
+
+	/* Copy direction is worked out per rectangle by the kernels */
+	const int bitsPerPixel = pPixmapDst->drawable.bitsPerPixel;
+	fPtr->copyFunc = imxExaGetCopyFunc(bitsPerPixel);
+	fPtr->copyOverlapFunc = imxExaGetCopyOverlapFunc(bitsPerPixel);
+	if ((NULL == fPtr->copyFunc) || (NULL == fPtr->copyOverlapFunc)) {
+		return FALSE;
+	}
+	fPtr->pCopySrc = pPixmapSrc;
+
+	imxExaMarkUsed(fPtr, fPixmapSrcPtr);
+	imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+	return TRUE;
+}
+
+static void
+imxExaCopy(PixmapPtr pPixmapDst, int srcX, int srcY, int dstX, int dstY,
+		int width, int height)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmapDst->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapSrcPtr = imxExaGetPixmapPrivate(fPtr->pCopySrc);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pPixmapDst);
+
+	unsigned char* pBufferDst =
+		imxExaPixelAddress(fPixmapDstPtr, dstX, dstY);
+	unsigned char* pBufferSrc =
+		imxExaPixelAddress(fPixmapSrcPtr, srcX, srcY);
+
+	/* Scrolling moves a rectangle onto itself; the rows must be */
+	/* moved in order, so this stays on one thread */
+	if ((fPixmapSrcPtr->ptr == fPixmapDstPtr->ptr) &&
+		(srcX < dstX + width) && (dstX < srcX + width) &&
+		(srcY < dstY + height) && (dstY < srcY + height)) {
+
+		(*fPtr->copyOverlapFunc)(
+			pBufferDst,
+			pBufferSrc,
+			width,
+			height,
+			fPixmapDstPtr->pitchBytes,
+			fPixmapSrcPtr->pitchBytes);
+		return;
+	}
+
+	imx_accel_pool_copy(
+		fPtr->pool,
+		fPtr->copyFunc,
+		pBufferDst,
+		pBufferSrc,
+		width,
+		height,
+		fPixmapDstPtr->pitchBytes,
+		fPixmapSrcPtr->pitchBytes);
+}
+
+static void
+imxExaDoneCopy(PixmapPtr pPixmapDst)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmapDst->drawable.pScreen);
+
+	fPtr->pCopySrc = NULL;
+}
+
+static Bool
+imxExaUploadToScreen(PixmapPtr pPixmapDst, int x, int y, int width,
+			int height, char* pBufferSrc, int pitchSrc)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmapDst->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pPixmapDst);
+	if ((NULL == fPixmapDstPtr) || (NULL == fPixmapDstPtr->ptr)) {
+		return FALSE;
+	}
+
+	imx_copy_sw_no_overlap_func uploadFunc =
+		imxExaGetUploadFunc(pPixmapDst->drawable.bitsPerPixel);
+	if (NULL == uploadFunc) {
+		return FALSE;
+	}
+
+	const int rowBytes = width * (pPixmapDst->drawable.bitsPerPixel >> 3);
+	const int size = rowBytes * height;
+
+	/* Small uploads to offscreen pixmaps wait in system memory, so */
+	/* that glyphs and the like reach the write-combined frame buffer */
+	/* in one pass.  The screen pixmap is read behind EXA's back, by */
+	/* the display and EPDC, so it is always written straight away. */
+	if ((size > 0) && (size <= IMX_EXA_UPLOAD_BATCH_SMALL) &&
+		(NULL != fPixmapDstPtr->pArea)) {
+
+		if ((IMX_EXA_UPLOAD_BATCH_MAX == fPtr->numUploads) ||
+			(fPtr->uploadBufferUsed + size >
+				IMX_EXA_UPLOAD_BATCH_BYTES)) {
+
+			imxExaFlushUploads(fPtr);
+		}
+
+		ImxExaUploadPtr pUpload = &fPtr->uploads[fPtr->numUploads++];
+		pUpload->fPixmapPtr = fPixmapDstPtr;
+		pUpload->x = x;
+		pUpload->y = y;
+		pUpload->width = width;
+		pUpload->height = height;
+		pUpload->offset = fPtr->uploadBufferUsed;
+		pUpload->pitch = rowBytes;
+
+		imx_copy_sw_no_overlap_8(
+			fPtr->uploadBuffer + pUpload->offset,
+			(unsigned char*)pBufferSrc,
+			rowBytes,
+			height,
+			rowBytes,
+			pitchSrc);
+
+		fPtr->uploadBufferUsed += IMX_ALIGN(size, 16);
+		imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+		return TRUE;
+	}
+
+	/* Earlier uploads may cover the same pixels */
+	imxExaFlushUploads(fPtr);
+
+	imx_accel_pool_copy(
+		fPtr->pool,
+		uploadFunc,
+		imxExaPixelAddress(fPixmapDstPtr, x, y),
+		(unsigned char*)pBufferSrc,
+		width,
+		height,
+		fPixmapDstPtr->pitchBytes,
+		pitchSrc);
+
+	return TRUE;
+}
+
+static Bool
+imxExaDownloadFromScreen(PixmapPtr pPixmapSrc, int x, int y, int width,
+			int height, char* pBufferDst, int pitchDst)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmapSrc->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapSrcPtr = imxExaGetPixmapPrivate(pPixmapSrc);
+	if ((NULL == fPixmapSrcPtr) || (NULL == fPixmapSrcPtr->ptr)) {
+		return FALSE;
+	}
+
+	imx_copy_sw_no_overlap_func downloadFunc =
+		imxExaGetDownloadFunc(pPixmapSrc->drawable.bitsPerPixel);
+	if (NULL == downloadFunc) {
+		return FALSE;
+	}
+
+	imxExaFlushUploads(fPtr);
+
+	imx_accel_pool_copy(
+		fPtr->pool,
+		downloadFunc,
+		(unsigned char*)pBufferDst,
+		imxExaPixelAddress(fPixmapSrcPtr, x, y),
+		width,
+		height,
+		pitchDst,
+		fPixmapSrcPtr->pitchBytes);
+
+	return TRUE;
+}
+
+/* -------------------------------------------------------------------- */
+
+/* Render composite operations with kernels */
+enum {
+	IMX_EXA_COMPOSITE_OVER_N_8_0565,	/* solid through a8 OVER r5g6b5 */
+	IMX_EXA_COMPOSITE_OVER_8888_0565,	/* a8r8g8b8 OVER r5g6b5 */
+	IMX_EXA_COMPOSITE_ADD_8_8		/* a8 ADD a8 */
+};
+
+/* Picture read pixel for pixel from a drawable */
+static Bool
+imxExaPictureIsPlain(PicturePtr pPicture)
+{
+	return (NULL != pPicture->pDrawable) &&
+		(NULL == pPicture->transform) &&
+		(NULL == pPicture->alphaMap) &&
+		!pPicture->componentAlpha &&
+		!pPicture->repeat;
+}
+
+/* Picture of one color, either a solid fill or a repeating 1x1 pixmap */
+static Bool
+imxExaPictureIsSolid(PicturePtr pPicture)
+{
+	if (NULL != pPicture->pSourcePict) {
+		return SourcePictTypeSolidFill == pPicture->pSourcePict->type;
+	}
+
+	return (NULL != pPicture->pDrawable) &&
+		(NULL == pPicture->alphaMap) &&
+		pPicture->repeat &&
+		(1 == pPicture->pDrawable->width) &&
+		(1 == pPicture->pDrawable->height) &&
+		((PICT_a8r8g8b8 == pPicture->format) ||
+			(PICT_x8r8g8b8 == pPicture->format));
+}
+
+/* Color of a picture that passed imxExaPictureIsSolid */
+static Bool
+imxExaGetSolidColor(PicturePtr pPicture, uint32_t* pColor)
+{
+	if (NULL != pPicture->pSourcePict) {
+
+		*pColor = pPicture->pSourcePict->solidFill.color;
+		return TRUE;
+	}
+
+	if (DRAWABLE_PIXMAP != pPicture->pDrawable->type) {
+		return FALSE;
+	}
+
+	ImxExaPixmapPtr fPixmapPtr =
+		imxExaGetPixmapPrivate((PixmapPtr)pPicture->pDrawable);
+	if ((NULL == fPixmapPtr) || (NULL == fPixmapPtr->ptr)) {
+		return FALSE;
+	}
+
+	*pColor = *(uint32_t*)fPixmapPtr->ptr;
+	if (PICT_x8r8g8b8 == pPicture->format) {
+		*pColor |= 0xFF000000;
+	}
+
+	return TRUE;
+}
+
+static Bool
+imxExaCheckComposite(int op, PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+			PicturePtr pDstPicture)
+{
+	if (NULL != pDstPicture->alphaMap) {
+		return FALSE;
+	}
+
+	switch (op) {
+
+	case PictOpOver:
+		if (PICT_r5g6b5 != pDstPicture->format) {
+			return FALSE;
+		}
+
+		/* Text and antialiased edges */
+		if (NULL != pMaskPicture) {
+			return imxExaPictureIsSolid(pSrcPicture) &&
+				imxExaPictureIsPlain(pMaskPicture) &&
+				(PICT_a8 == pMaskPicture->format);
+		}
+
+		/* Images with alpha */
+		return imxExaPictureIsPlain(pSrcPicture) &&
+			(PICT_a8r8g8b8 == pSrcPicture->format);
+
+	case PictOpAdd:
+		/* Accumulating glyph masks */
+		return (NULL == pMaskPicture) &&
+			(PICT_a8 == pDstPicture->format) &&
+			imxExaPictureIsPlain(pSrcPicture) &&
+			(PICT_a8 == pSrcPicture->format);
+	}
+
+	return FALSE;
+}
+
+static Bool
+imxExaPrepareComposite(int op, PicturePtr pSrcPicture,
+			PicturePtr pMaskPicture, PicturePtr pDstPicture,
+			PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pDst->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pDst);
+	ImxExaPixmapPtr fPixmapSrcPtr =
+		(NULL != pSrc) ? imxExaGetPixmapPrivate(pSrc) : NULL;
+	ImxExaPixmapPtr fPixmapMaskPtr =
+		(NULL != pMask) ? imxExaGetPixmapPrivate(pMask) : NULL;
+
+	imxExaFlushUploads(fPtr);
+
+	if (!imxExaCheckComposite(op, pSrcPicture, pMaskPicture, pDstPicture)) {
+		return FALSE;
+	}
+
+	if ((NULL == fPixmapDstPtr) || (NULL == fPixmapDstPtr->ptr)) {
+		return FALSE;
+	}
+
+	/* Solid source through a mask */
+	if (NULL != pMaskPicture) {
+
+		if ((NULL == fPixmapMaskPtr) || (NULL == fPixmapMaskPtr->ptr)) {
+			return FALSE;
+		}
+
+		if (!imxExaGetSolidColor(pSrcPicture, &fPtr->compositeColor)) {
+			return FALSE;
+		}
+
+		fPtr->compositeOp = IMX_EXA_COMPOSITE_OVER_N_8_0565;
+		fPtr->pCompositeSrc = NULL;
+		fPtr->pCompositeMask = pMask;
+
+		imxExaMarkUsed(fPtr, fPixmapMaskPtr);
+		imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+		return TRUE;
+	}
+
+	if ((NULL == fPixmapSrcPtr) || (NULL == fPixmapSrcPtr->ptr)) {
+		return FALSE;
+	}
+
+	fPtr->compositeOp = (PictOpAdd == op) ?
+		IMX_EXA_COMPOSITE_ADD_8_8 : IMX_EXA_COMPOSITE_OVER_8888_0565;
+	fPtr->pCompositeSrc = pSrc;
+	fPtr->pCompositeMask = NULL;
+
+	imxExaMarkUsed(fPtr, fPixmapSrcPtr);
+	imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+	return TRUE;
+}
+
+static void
+imxExaComposite(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
+		int dstX, int dstY, int width, int height)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pDst->drawable.pScreen);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pDst);
+	ImxExaPixmapPtr fPixmapSrcPtr;
+	ImxExaPixmapPtr fPixmapMaskPtr;
+
+	unsigned char* pBufferDst =
+		imxExaPixelAddress(fPixmapDstPtr, dstX, dstY);
+
+	switch (fPtr->compositeOp) {
+
+	case IMX_EXA_COMPOSITE_OVER_N_8_0565:
+		fPixmapMaskPtr = imxExaGetPixmapPrivate(fPtr->pCompositeMask);
+		imx_accel_pool_composite_mask(
+			fPtr->pool,
+			imx_composite_sw_over_n_8_0565,
+			pBufferDst,
+			imxExaPixelAddress(fPixmapMaskPtr, maskX, maskY),
+			width,
+			height,
+			fPixmapDstPtr->pitchBytes,
+			fPixmapMaskPtr->pitchBytes,
+			fPtr->compositeColor);
+		break;
+
+	case IMX_EXA_COMPOSITE_OVER_8888_0565:
+		fPixmapSrcPtr = imxExaGetPixmapPrivate(fPtr->pCompositeSrc);
+		imx_accel_pool_copy(
+			fPtr->pool,
+			imx_composite_sw_over_8888_0565,
+			pBufferDst,
+			imxExaPixelAddress(fPixmapSrcPtr, srcX, srcY),
+			width,
+			height,
+			fPixmapDstPtr->pitchBytes,
+			fPixmapSrcPtr->pitchBytes);
+		break;
+
+	case IMX_EXA_COMPOSITE_ADD_8_8:
+		fPixmapSrcPtr = imxExaGetPixmapPrivate(fPtr->pCompositeSrc);
+		imx_accel_pool_copy(
+			fPtr->pool,
+			imx_composite_sw_add_8_8,
+			pBufferDst,
+			imxExaPixelAddress(fPixmapSrcPtr, srcX, srcY),
+			width,
+			height,
+			fPixmapDstPtr->pitchBytes,
+			fPixmapSrcPtr->pitchBytes);
+		break;
+	}
+}
+
+static void
+imxExaDoneComposite(PixmapPtr pDst)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pDst->drawable.pScreen);
+
+	fPtr->pCompositeSrc = NULL;
+	fPtr->pCompositeMask = NULL;
+}
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Glyph atlas.  Text arrives as runs of a8 glyphs composited with a
+ * solid source, which generic code renders one glyph at a time from
+ * the glyph pixmaps.  Instead the glyphs are copied into cells of an
+ * atlas in offscreen memory, found again by glyph and format, and a
+ * whole run is composited from the atlas in one pass per clip box.
+ */
+
+/* Atlas rows are this many a8 pixels; the top rows hold the small */
+/* cells and the rest the large ones */
+#define	IMX_EXA_GLYPH_ATLAS_PITCH	512
+#define	IMX_EXA_GLYPH_SMALL_ROWS	128
+#define	IMX_EXA_GLYPH_LARGE_ROWS	256
+#define	IMX_EXA_GLYPH_ATLAS_SIZE	(IMX_EXA_GLYPH_ATLAS_PITCH * \
+			(IMX_EXA_GLYPH_SMALL_ROWS + IMX_EXA_GLYPH_LARGE_ROWS))
+
+/* Cell sizes, larger glyphs are left to generic code */
+#define	IMX_EXA_GLYPH_SMALL_CELL	16
+#define	IMX_EXA_GLYPH_LARGE_CELL	32
+
+/* Glyphs collected before they are drawn */
+#define	IMX_EXA_GLYPH_RUN_MAX		128
+
+/* Glyph to be drawn from the atlas, in clip coordinates */
+typedef struct {
+	int				x;
+	int				y;
+	int				width;
+	int				height;
+	int				offset;
+} ImxExaGlyphDrawRec, *ImxExaGlyphDrawPtr;
+
+/* Pixmap drawn into for a drawable, with the offset from screen */
+/* coordinates to pixmap coordinates */
+static PixmapPtr
+imxExaGetDrawablePixmap(DrawablePtr pDrawable, int* pXoff, int* pYoff)
+{
+	*pXoff = 0;
+	*pYoff = 0;
+
+	if (DRAWABLE_WINDOW != pDrawable->type) {
+		return (PixmapPtr)pDrawable;
+	}
+
+	PixmapPtr pPixmap =
+		(*pDrawable->pScreen->GetWindowPixmap)((WindowPtr)pDrawable);
+#ifdef COMPOSITE
+	*pXoff = -pPixmap->screen_x;
+	*pYoff = -pPixmap->screen_y;
+#endif
+	return pPixmap;
+}
+
+static unsigned
+imxExaGlyphHash(GlyphPtr pGlyph)
+{
+	return ((unsigned long)pGlyph >> 4) & (IMX_EXA_GLYPH_HASH_SIZE - 1);
+}
+
+static void
+imxExaGlyphLruUnlink(ImxExaGlyphEntryPtr pEntry)
+{
+	pEntry->pLruPrev->pLruNext = pEntry->pLruNext;
+	pEntry->pLruNext->pLruPrev = pEntry->pLruPrev;
+}
+
+/* Put the entry at the most recently used end */
+static void
+imxExaGlyphLruAppend(ImxExaGlyphClassPtr pClass, ImxExaGlyphEntryPtr pEntry)
+{
+	pEntry->pLruPrev = pClass->lru.pLruPrev;
+	pEntry->pLruNext = &pClass->lru;
+	pClass->lru.pLruPrev->pLruNext = pEntry;
+	pClass->lru.pLruPrev = pEntry;
+}
+
+/* Put the entry at the least recently used end */
+static void
+imxExaGlyphLruPrepend(ImxExaGlyphClassPtr pClass, ImxExaGlyphEntryPtr pEntry)
+{
+	pEntry->pLruPrev = &pClass->lru;
+	pEntry->pLruNext = pClass->lru.pLruNext;
+	pClass->lru.pLruNext->pLruPrev = pEntry;
+	pClass->lru.pLruNext = pEntry;
+}
+
+static ImxExaGlyphClassPtr
+imxExaGlyphClass(ImxExaPtr fPtr, int width, int height)
+{
+	int i;
+
+	for (i = 0; i < IMX_EXA_GLYPH_CLASSES; ++i) {
+
+		ImxExaGlyphClassPtr pClass = &fPtr->glyphClasses[i];
+		if ((width <= pClass->cellSize) && (height <= pClass->cellSize)) {
+			return pClass;
+		}
+	}
+
+	return NULL;
+}
+
+/* Forget every glyph, and lay out the cells again */
+static void
+imxExaGlyphsReset(ImxExaPtr fPtr)
+{
+	static const int cellSize[IMX_EXA_GLYPH_CLASSES] = {
+		IMX_EXA_GLYPH_SMALL_CELL, IMX_EXA_GLYPH_LARGE_CELL };
+	static const int rows[IMX_EXA_GLYPH_CLASSES] = {
+		IMX_EXA_GLYPH_SMALL_ROWS, IMX_EXA_GLYPH_LARGE_ROWS };
+
+	ImxExaGlyphEntryPtr pEntry = fPtr->glyphEntries;
+	int offset = 0;
+	int i, x, y;
+
+	memset(fPtr->glyphHash, 0, sizeof(fPtr->glyphHash));
+
+	for (i = 0; i < IMX_EXA_GLYPH_CLASSES; ++i) {
+
+		ImxExaGlyphClassPtr pClass = &fPtr->glyphClasses[i];
+		pClass->cellSize = cellSize[i];
+		pClass->lru.pLruPrev = &pClass->lru;
+		pClass->lru.pLruNext = &pClass->lru;
+
+		for (y = 0; y + cellSize[i] <= rows[i]; y += cellSize[i]) {
+			for (x = 0; x + cellSize[i] <= IMX_EXA_GLYPH_ATLAS_PITCH;
+					x += cellSize[i]) {
+
+				pEntry->pGlyph = NULL;
+				pEntry->pHashNext = NULL;
+				pEntry->offset = offset +
+					y * IMX_EXA_GLYPH_ATLAS_PITCH + x;
+				pEntry->run = 0;
+				imxExaGlyphLruAppend(pClass, pEntry);
+				++pEntry;
+			}
+		}
+
+		offset += rows[i] * IMX_EXA_GLYPH_ATLAS_PITCH;
+	}
+
+	fPtr->glyphRun = 1;
+}
+
+/* Atlas is about to be given to a pixmap; its glyphs are dropped */
+static void
+imxExaGlyphAtlasSave(ScreenPtr pScreen, ExaOffscreenArea* pArea)
+{
+	ImxExaPtr fPtr = (ImxExaPtr)pArea->privData;
+
+	fPtr->pGlyphArea = NULL;
+	imxExaGlyphsReset(fPtr);
+}
+
+static ImxExaGlyphEntryPtr
+imxExaGlyphLookup(ImxExaPtr fPtr, GlyphPtr pGlyph, CARD32 format)
+{
+	ImxExaGlyphEntryPtr pEntry = fPtr->glyphHash[imxExaGlyphHash(pGlyph)];
+
+	while ((NULL != pEntry) &&
+		((pGlyph != pEntry->pGlyph) || (format != pEntry->format))) {
+		pEntry = pEntry->pHashNext;
+	}
+
+	return pEntry;
+}
+
+static void
+imxExaGlyphUnhash(ImxExaPtr fPtr, ImxExaGlyphEntryPtr pEntry)
+{
+	ImxExaGlyphEntryPtr* ppEntry =
+		&fPtr->glyphHash[imxExaGlyphHash(pEntry->pGlyph)];
+
+	while (pEntry != *ppEntry) {
+		ppEntry = &(*ppEntry)->pHashNext;
+	}
+	*ppEntry = pEntry->pHashNext;
+
+	pEntry->pGlyph = NULL;
+	pEntry->pHashNext = NULL;
+}
+
+/* Copy the glyph into the least recently used cell of its size.  */
+/* Returns NULL when every cell holds a glyph of the current run. */
+static ImxExaGlyphEntryPtr
+imxExaGlyphInsert(ScreenPtr pScreen, ImxExaPtr fPtr, GlyphPtr pGlyph,
+			CARD32 format)
+{
+	ImxExaGlyphClassPtr pClass =
+		imxExaGlyphClass(fPtr, pGlyph->info.width, pGlyph->info.height);
+
+	ImxExaGlyphEntryPtr pEntry = pClass->lru.pLruNext;
+	if (fPtr->glyphRun == pEntry->run) {
+		return NULL;
+	}
+
+	if (NULL != pEntry->pGlyph) {
+		imxExaGlyphUnhash(fPtr, pEntry);
+	}
+
+	PicturePtr pPicture = GlyphPicture(pGlyph)[pScreen->myNum];
+	ImxExaPixmapPtr fPixmapPtr =
+		imxExaGetPixmapPrivate((PixmapPtr)pPicture->pDrawable);
+
+	imx_copy_sw_no_overlap_8(
+		(unsigned char*)fPtr->exaDriverPtr->memoryBase +
+			fPtr->pGlyphArea->offset + pEntry->offset,
+		fPixmapPtr->ptr,
+		pGlyph->info.width,
+		pGlyph->info.height,
+		IMX_EXA_GLYPH_ATLAS_PITCH,
+		fPixmapPtr->pitchBytes);
+
+	const unsigned hash = imxExaGlyphHash(pGlyph);
+	pEntry->pGlyph = pGlyph;
+	pEntry->format = format;
+	pEntry->pHashNext = fPtr->glyphHash[hash];
+	fPtr->glyphHash[hash] = pEntry;
+
+	return pEntry;
+}
+
+/* Composite the collected glyphs from the atlas, one clip box at a */
+/* time so that the destination is walked in order. */
+static void
+imxExaGlyphsDraw(ImxExaPtr fPtr, ImxExaPixmapPtr fPixmapDstPtr,
+			int xPixmap, int yPixmap, RegionPtr pClip,
+			uint32_t color, ImxExaGlyphDrawPtr pDraws, int numDraws)
+{
+	const unsigned char* pAtlas =
+		(const unsigned char*)fPtr->exaDriverPtr->memoryBase +
+			fPtr->pGlyphArea->offset;
+
+	BoxPtr pBox = REGION_RECTS(pClip);
+	int nBox = REGION_NUM_RECTS(pClip);
+	int i;
+
+	for (; nBox > 0; --nBox, ++pBox) {
+
+		for (i = 0; i < numDraws; ++i) {
+
+			ImxExaGlyphDrawPtr pDraw = &pDraws[i];
+
+			const int x1 = max(pDraw->x, pBox->x1);
+			const int y1 = max(pDraw->y, pBox->y1);
+			const int x2 = min(pDraw->x + pDraw->width, pBox->x2);
+			const int y2 = min(pDraw->y + pDraw->height, pBox->y2);
+			if ((x1 >= x2) || (y1 >= y2)) {
+				continue;
+			}
+
+			imx_composite_sw_over_n_8_0565(
+				imxExaPixelAddress(fPixmapDstPtr,
+					x1 + xPixmap, y1 + yPixmap),
+				(unsigned char*)pAtlas + pDraw->offset +
+					(y1 - pDraw->y) * IMX_EXA_GLYPH_ATLAS_PITCH +
+					(x1 - pDraw->x),
+				x2 - x1,
+				y2 - y1,
+				fPixmapDstPtr->pitchBytes,
+				IMX_EXA_GLYPH_ATLAS_PITCH,
+				color);
+		}
+	}
+}
+
+/* Can every glyph of the run come from the atlas? */
+static Bool
+imxExaGlyphsCheck(ScreenPtr pScreen, ImxExaPtr fPtr, PictFormatPtr maskFormat,
+			int nlist, GlyphListPtr list, GlyphPtr* glyphs)
+{
+	int x = 0;
+	int y = 0;
+	int n;
+
+	/* Through a mask, overlapping glyphs add up before being */
+	/* composited, which drawing them one at a time does not do */
+	BoxRec extents = { MAXSHORT, MAXSHORT, MINSHORT, MINSHORT };
+
+	for (; nlist > 0; --nlist, ++list) {
+
+		x += list->xOff;
+		y += list->yOff;
+
+		if (PICT_a8 != list->format->format) {
+			return FALSE;
+		}
+
+		for (n = list->len; n > 0; --n) {
+
+			GlyphPtr pGlyph = *glyphs++;
+			const int width = pGlyph->info.width;
+			const int height = pGlyph->info.height;
+
+			if ((width > 0) && (height > 0)) {
+
+				if (NULL == imxExaGlyphClass(fPtr, width, height)) {
+					return FALSE;
+				}
+
+				PicturePtr pPicture =
+					GlyphPicture(pGlyph)[pScreen->myNum];
+				if ((NULL == pPicture) ||
+					(NULL == pPicture->pDrawable) ||
+					(PICT_a8 != pPicture->format)) {
+					return FALSE;
+				}
+
+				ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(
+					(PixmapPtr)pPicture->pDrawable);
+				if ((NULL == fPixmapPtr) || (NULL == fPixmapPtr->ptr)) {
+					return FALSE;
+				}
+
+				const int x1 = x - pGlyph->info.x;
+				const int y1 = y - pGlyph->info.y;
+				if (NULL != maskFormat) {
+
+					if ((x1 < extents.x2) &&
+						(x1 + width > extents.x1) &&
+						(y1 < extents.y2) &&
+						(y1 + height > extents.y1)) {
+						return FALSE;
+					}
+
+					extents.x1 = min(extents.x1, x1);
+					extents.y1 = min(extents.y1, y1);
+					extents.x2 = max(extents.x2, x1 + width);
+					extents.y2 = max(extents.y2, y1 + height);
+				}
+			}
+
+			x += pGlyph->info.xOff;
+			y += pGlyph->info.yOff;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Draw solid text onto r5g6b5 from the atlas.  Returns FALSE, having */
+/* drawn nothing, for anything else. */
+static Bool
+imxExaGlyphsFromAtlas(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+			PictFormatPtr maskFormat, int nlist,
+			GlyphListPtr list, GlyphPtr* glyphs)
+{
+	ScreenPtr pScreen = pDst->pDrawable->pScreen;
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+	ImxExaGlyphDrawRec draws[IMX_EXA_GLYPH_RUN_MAX];
+	int numDraws = 0;
+	uint32_t color;
+	int n;
+
+	if ((PictOpOver != op) ||
+		(PICT_r5g6b5 != pDst->format) ||
+		(NULL != pDst->alphaMap) ||
+		!imxExaPictureIsSolid(pSrc) ||
+		((NULL != maskFormat) && (PICT_a8 != maskFormat->format))) {
+		return FALSE;
+	}
+
+	imxExaFlushUploads(fPtr);
+
+	int xPixmap, yPixmap;
+	PixmapPtr pPixmapDst =
+		imxExaGetDrawablePixmap(pDst->pDrawable, &xPixmap, &yPixmap);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pPixmapDst);
+	if ((NULL == fPixmapDstPtr) || (NULL == fPixmapDstPtr->ptr) ||
+		!imxExaGetSolidColor(pSrc, &color)) {
+		return FALSE;
+	}
+
+	/* Nothing is drawn unless the whole run can be, so that the */
+	/* run can still go to generic code */
+	if (!imxExaGlyphsCheck(pScreen, fPtr, maskFormat, nlist, list, glyphs)) {
+		return FALSE;
+	}
+
+	/* Atlas is allocated when a run first needs it, and again after */
+	/* being evicted; this may move other pixmaps to system memory, */
+	/* so runs going to generic code must not get this far. */
+	if (NULL == fPtr->pGlyphArea) {
+
+		fPtr->pGlyphArea = imxExaOffscreenAlloc(pScreen,
+					IMX_EXA_GLYPH_ATLAS_SIZE,
+					IMX_EXA_PIXMAP_ALIGN, FALSE,
+					imxExaGlyphAtlasSave, fPtr);
+		if (NULL == fPtr->pGlyphArea) {
+			return FALSE;
+		}
+	}
+
+	ValidatePicture(pDst);
+	RegionPtr pClip = pDst->pCompositeClip;
+
+	imxExaOffscreenMarkUsed(fPtr, fPtr->pGlyphArea);
+	imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+	/* Glyph positions, in the coordinates of the clip */
+	int x = pDst->pDrawable->x;
+	int y = pDst->pDrawable->y;
+
+	for (; nlist > 0; --nlist, ++list) {
+
+		x += list->xOff;
+		y += list->yOff;
+
+		for (n = list->len; n > 0; --n) {
+
+			GlyphPtr pGlyph = *glyphs++;
+
+			if ((pGlyph->info.width > 0) && (pGlyph->info.height > 0)) {
+
+				/* Glyphs collected so far are drawn when the */
+				/* run outgrows the list or the atlas */
+				ImxExaGlyphEntryPtr pEntry =
+					imxExaGlyphLookup(fPtr, pGlyph, PICT_a8);
+				if (NULL == pEntry) {
+					pEntry = imxExaGlyphInsert(pScreen, fPtr,
+							pGlyph, PICT_a8);
+				}
+				if ((NULL == pEntry) ||
+					(IMX_EXA_GLYPH_RUN_MAX == numDraws)) {
+
+					imxExaGlyphsDraw(fPtr, fPixmapDstPtr,
+						xPixmap, yPixmap, pClip, color,
+						draws, numDraws);
+					numDraws = 0;
+					++fPtr->glyphRun;
+
+					if (NULL == pEntry) {
+						pEntry = imxExaGlyphInsert(pScreen,
+							fPtr, pGlyph, PICT_a8);
+					}
+				}
+
+				pEntry->run = fPtr->glyphRun;
+				imxExaGlyphLruUnlink(pEntry);
+				imxExaGlyphLruAppend(imxExaGlyphClass(fPtr,
+					pGlyph->info.width, pGlyph->info.height),
+					pEntry);
+
+				ImxExaGlyphDrawPtr pDraw = &draws[numDraws++];
+				pDraw->x = x - pGlyph->info.x;
+				pDraw->y = y - pGlyph->info.y;
+				pDraw->width = pGlyph->info.width;
+				pDraw->height = pGlyph->info.height;
+				pDraw->offset = pEntry->offset;
+			}
+
+			x += pGlyph->info.xOff;
+			y += pGlyph->info.yOff;
+		}
+	}
+
+	imxExaGlyphsDraw(fPtr, fPixmapDstPtr, xPixmap, yPixmap, pClip, color,
+			draws, numDraws);
+	++fPtr->glyphRun;
+
+	return TRUE;
+}
+
+static void
+imxExaGlyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+		PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+		int nlist, GlyphListPtr list, GlyphPtr* glyphs)
+{
+	ScreenPtr pScreen = pDst->pDrawable->pScreen;
+	PictureScreenPtr ps = GetPictureScreen(pScreen);
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+
+	if (imxExaGlyphsFromAtlas(op, pSrc, pDst, maskFormat, nlist, list,
+			glyphs)) {
+		return;
+	}
+
+	ps->Glyphs = fPtr->saveGlyphs;
+	(*ps->Glyphs)(op, pSrc, pDst, maskFormat, xSrc, ySrc, nlist, list,
+			glyphs);
+	fPtr->saveGlyphs = ps->Glyphs;
+	ps->Glyphs = imxExaGlyphs;
+}
+
+/* Glyph is going away, so is its cell */
+static void
+imxExaUnrealizeGlyph(ScreenPtr pScreen, GlyphPtr pGlyph)
+{
+	PictureScreenPtr ps = GetPictureScreen(pScreen);
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+	ImxExaGlyphEntryPtr pEntry;
+
+	while (NULL != (pEntry = imxExaGlyphLookup(fPtr, pGlyph, PICT_a8))) {
+
+		imxExaGlyphUnhash(fPtr, pEntry);
+		imxExaGlyphLruUnlink(pEntry);
+		imxExaGlyphLruPrepend(imxExaGlyphClass(fPtr,
+			pGlyph->info.width, pGlyph->info.height), pEntry);
+	}
+
+	ps->UnrealizeGlyph = fPtr->saveUnrealizeGlyph;
+	(*ps->UnrealizeGlyph)(pScreen, pGlyph);
+	fPtr->saveUnrealizeGlyph = ps->UnrealizeGlyph;
+	ps->UnrealizeGlyph = imxExaUnrealizeGlyph;
+}
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Trapezoids and triangles.  Antialiased shapes arrive as trapezoids,
+ * or triangles that split into them, which generic code rasterizes
+ * into an a8 mask pixmap covering all the shapes before compositing
+ * it.  Instead the coverage is rasterized a band of rows at a time
+ * into a small buffer, and each band goes straight to the composite
+ * kernel.
+ */
+
+/* Size of the coverage buffer; a band is as many rows as fit */
+#define	IMX_EXA_TRAP_BAND_BYTES		(32 * 1024)
+
+/* Rows of samples in each pixel row, placed as pixman does for a8 */
+/* masks, and the coverage a sample row gives a whole pixel */
+#define	IMX_EXA_TRAP_SAMPLE_ROWS	15
+#define	IMX_EXA_TRAP_SAMPLE_STEP	(xFixed1 / IMX_EXA_TRAP_SAMPLE_ROWS)
+#define	IMX_EXA_TRAP_SAMPLE_FIRST	(IMX_EXA_TRAP_SAMPLE_STEP / 2)
+#define	IMX_EXA_TRAP_SAMPLE_COVERAGE	17
+
+/* X of the line at y, all in 16.16 fixed point */
+static int64_t
+imxExaLineX(const xLineFixed* pLine, xFixed y)
+{
+	return pLine->p1.x + (int64_t)(y - pLine->p1.y) *
+		(pLine->p2.x - pLine->p1.x) / (pLine->p2.y - pLine->p1.y);
+}
+
+/* Trapezoid with an area, as pixman checks */
+static Bool
+imxExaTrapIsValid(const xTrapezoid* pTrap)
+{
+	return (pTrap->left.p1.y != pTrap->left.p2.y) &&
+		(pTrap->right.p1.y != pTrap->right.p2.y) &&
+		(pTrap->bottom > pTrap->top);
+}
+
+/* Split a triangle into at most two trapezoids; returns how many */
+static int
+imxExaTriangleToTraps(const xTriangle* pTri, xTrapezoid* pTraps)
+{
+	const xPointFixed* pTop = &pTri->p1;
+	const xPointFixed* pMiddle = &pTri->p2;
+	const xPointFixed* pBottom = &pTri->p3;
+	const xPointFixed* pTemp;
+	int numTraps = 0;
+
+	if (pMiddle->y < pTop->y) {
+		pTemp = pTop; pTop = pMiddle; pMiddle = pTemp;
+	}
+	if (pBottom->y < pMiddle->y) {
+		pTemp = pMiddle; pMiddle = pBottom; pBottom = pTemp;
+	}
+	if (pMiddle->y < pTop->y) {
+		pTemp = pTop; pTop = pMiddle; pMiddle = pTemp;
+	}
+
+	if (pTop->y == pBottom->y) {
+		return 0;
+	}
+
+	/* Long edge from top to bottom is on one side of both halves */
+	xLineFixed longEdge = { *pTop, *pBottom };
+	const Bool middleLeft = pMiddle->x < imxExaLineX(&longEdge, pMiddle->y);
+
+	if (pTop->y < pMiddle->y) {
+
+		xLineFixed upperEdge = { *pTop, *pMiddle };
+		xTrapezoid* pTrap = &pTraps[numTraps++];
+		pTrap->top = pTop->y;
+		pTrap->bottom = pMiddle->y;
+		pTrap->left = middleLeft ? upperEdge : longEdge;
+		pTrap->right = middleLeft ? longEdge : upperEdge;
+	}
+
+	if (pMiddle->y < pBottom->y) {
+
+		xLineFixed lowerEdge = { *pMiddle, *pBottom };
+		xTrapezoid* pTrap = &pTraps[numTraps++];
+		pTrap->top = pMiddle->y;
+		pTrap->bottom = pBottom->y;
+		pTrap->left = middleLeft ? lowerEdge : longEdge;
+		pTrap->right = middleLeft ? longEdge : lowerEdge;
+	}
+
+	return numTraps;
+}
+
+/* Pixels the trapezoid touches */
+static void
+imxExaTrapBounds(const xTrapezoid* pTrap, int* pX1, int* pY1, int* pX2,
+			int* pY2)
+{
+	/* Lines are extended to the top and bottom, which can take */
+	/* them far outside the drawable */
+	const int64_t left = max(min(imxExaLineX(&pTrap->left, pTrap->top),
+				imxExaLineX(&pTrap->left, pTrap->bottom)),
+				(int64_t)MINSHORT * xFixed1);
+	const int64_t right = min(max(imxExaLineX(&pTrap->right, pTrap->top),
+				imxExaLineX(&pTrap->right, pTrap->bottom)),
+				(int64_t)MAXSHORT * xFixed1);
+
+	*pX1 = (int)(left >> 16);
+	*pY1 = xFixedToInt(pTrap->top);
+	*pX2 = (int)((right + xFixed1 - 1) >> 16);
+	*pY2 = xFixedToInt(pTrap->bottom + xFixed1 - 1);
+}
+
+/* Coverage of the trapezoid in pixel row y, added to a row of width */
+/* pixels starting at x.  Each sample row covers the exact fraction of */
+/* its edge pixels, rounded.  Widens [*pMin, *pMax) to the pixels */
+/* touched. */
+static void
+imxExaTrapRow(const xTrapezoid* pTrap, int y, unsigned char* pRow, int x,
+		int width, int* pMin, int* pMax)
+{
+	const int64_t rowLeft = (int64_t)IntToxFixed(x);
+	const int64_t rowRight = rowLeft + IntToxFixed(width);
+	int i;
+
+	for (i = 0; i < IMX_EXA_TRAP_SAMPLE_ROWS; ++i) {
+
+		const xFixed ySample = IntToxFixed(y) +
+			IMX_EXA_TRAP_SAMPLE_FIRST + i * IMX_EXA_TRAP_SAMPLE_STEP;
+		if ((ySample < pTrap->top) || (ySample >= pTrap->bottom)) {
+			continue;
+		}
+
+		/* Span of the sample row within the row */
+		const int64_t spanLeft =
+			max(imxExaLineX(&pTrap->left, ySample), rowLeft);
+		const int64_t spanRight =
+			min(imxExaLineX(&pTrap->right, ySample), rowRight);
+		if (spanLeft >= spanRight) {
+			continue;
+		}
+
+		/* Relative to the start of the row from here on */
+		const int left = (int)(spanLeft - rowLeft);
+		const int right = (int)(spanRight - rowLeft);
+
+		const int first = xFixedToInt(left);
+		const int last = xFixedToInt(right);
+
+		if (first == last) {
+
+			pRow[first] += ((right - left) *
+				IMX_EXA_TRAP_SAMPLE_COVERAGE + 0x8000) >> 16;
+
+		} else {
+
+			pRow[first] += ((xFixed1 - xFixedFrac(left)) *
+				IMX_EXA_TRAP_SAMPLE_COVERAGE + 0x8000) >> 16;
+			imx_coverage_sw_add_8(pRow + first + 1, last - first - 1,
+				IMX_EXA_TRAP_SAMPLE_COVERAGE);
+			if (last < width) {
+				pRow[last] += (xFixedFrac(right) *
+					IMX_EXA_TRAP_SAMPLE_COVERAGE + 0x8000) >> 16;
+			}
+		}
+
+		*pMin = min(*pMin, first);
+		*pMax = max(*pMax, min(last + 1, width));
+	}
+}
+
+/* Rasterize solid shapes onto r5g6b5.  Returns FALSE, having drawn */
+/* nothing, for anything else.  Without a mask format the shapes are */
+/* composited one at a time, so only a single shape is taken then. */
+static Bool
+imxExaRasterizeTraps(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+			PictFormatPtr maskFormat, Bool oneShape,
+			int ntrap, const xTrapezoid* traps)
+{
+	ScreenPtr pScreen = pDst->pDrawable->pScreen;
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+	uint32_t color;
+	int i, y;
+
+	if ((PictOpOver != op) ||
+		(PICT_r5g6b5 != pDst->format) ||
+		(NULL != pDst->alphaMap) ||
+		!imxExaPictureIsSolid(pSrc)) {
+		return FALSE;
+	}
+
+	if ((NULL != maskFormat) ? (PICT_a8 != maskFormat->format) :
+		(!oneShape || (PolyEdgeSmooth != pDst->polyEdge))) {
+		return FALSE;
+	}
+
+	imxExaFlushUploads(fPtr);
+
+	int xPixmap, yPixmap;
+	PixmapPtr pPixmapDst =
+		imxExaGetDrawablePixmap(pDst->pDrawable, &xPixmap, &yPixmap);
+	ImxExaPixmapPtr fPixmapDstPtr = imxExaGetPixmapPrivate(pPixmapDst);
+	if ((NULL == fPixmapDstPtr) || (NULL == fPixmapDstPtr->ptr) ||
+		!imxExaGetSolidColor(pSrc, &color)) {
+		return FALSE;
+	}
+
+	ValidatePicture(pDst);
+	RegionPtr pClip = pDst->pCompositeClip;
+
+	/* Shapes are in drawable coordinates, the clip in screen ones */
+	const int xDrawable = pDst->pDrawable->x;
+	const int yDrawable = pDst->pDrawable->y;
+
+	/* Pixels to rasterize, the shapes' extents within the clip */
+	BoxPtr pExtents = REGION_EXTENTS(pScreen, pClip);
+	int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+
+	for (i = 0; i < ntrap; ++i) {
+
+		int trapX1, trapY1, trapX2, trapY2;
+
+		if (imxExaTrapIsValid(&traps[i])) {
+
+			imxExaTrapBounds(&traps[i], &trapX1, &trapY1,
+					&trapX2, &trapY2);
+			x1 = min(x1, trapX1);
+			y1 = min(y1, trapY1);
+			x2 = max(x2, trapX2);
+			y2 = max(y2, trapY2);
+		}
+	}
+
+	x1 = max(x1, pExtents->x1 - xDrawable);
+	y1 = max(y1, pExtents->y1 - yDrawable);
+	x2 = min(x2, pExtents->x2 - xDrawable);
+	y2 = min(y2, pExtents->y2 - yDrawable);
+	if ((x1 >= x2) || (y1 >= y2)) {
+		return TRUE;
+	}
+
+	/* Coverage of a band, and of one shape in one row of it */
+	const int width = x2 - x1;
+	const int bandRows =
+		min(y2 - y1, max(1, IMX_EXA_TRAP_BAND_BYTES / width));
+	unsigned char* pBand = calloc(width, bandRows + 1);
+	if (NULL == pBand) {
+		return FALSE;
+	}
+	unsigned char* pRow = pBand + width * bandRows;
+
+	imxExaMarkUsed(fPtr, fPixmapDstPtr);
+
+	int bandY;
+	for (bandY = y1; bandY < y2; bandY += bandRows) {
+
+		const int bandY2 = min(bandY + bandRows, y2);
+		memset(pBand, 0, width * (bandY2 - bandY));
+
+		/* Shapes add up, saturating, as they do in a mask */
+		for (i = 0; i < ntrap; ++i) {
+
+			const xTrapezoid* pTrap = &traps[i];
+			if (!imxExaTrapIsValid(pTrap)) {
+				continue;
+			}
+
+			const int trapY1 = max(bandY, xFixedToInt(pTrap->top));
+			const int trapY2 = min(bandY2,
+				xFixedToInt(pTrap->bottom + xFixed1 - 1));
+
+			for (y = trapY1; y < trapY2; ++y) {
+
+				int rowMin = width;
+				int rowMax = 0;
+
+				imxExaTrapRow(pTrap, y, pRow, x1, width,
+						&rowMin, &rowMax);
+				if (rowMin >= rowMax) {
+					continue;
+				}
+
+				imx_composite_sw_add_8_8(
+					pBand + (y - bandY) * width + rowMin,
+					pRow + rowMin,
+					rowMax - rowMin,
+					1,
+					width,
+					width);
+				memset(pRow + rowMin, 0, rowMax - rowMin);
+			}
+		}
+
+		/* Band through the clip onto the destination */
+		BoxPtr pBox = REGION_RECTS(pClip);
+		int nBox = REGION_NUM_RECTS(pClip);
+
+		for (; nBox > 0; --nBox, ++pBox) {
+
+			const int boxX1 = max(x1, pBox->x1 - xDrawable);
+			const int boxY1 = max(bandY, pBox->y1 - yDrawable);
+			const int boxX2 = min(x2, pBox->x2 - xDrawable);
+			const int boxY2 = min(bandY2, pBox->y2 - yDrawable);
+			if ((boxX1 >= boxX2) || (boxY1 >= boxY2)) {
+				continue;
+			}
+
+			imx_accel_pool_composite_mask(
+				fPtr->pool,
+				imx_composite_sw_over_n_8_0565,
+				imxExaPixelAddress(fPixmapDstPtr,
+					boxX1 + xDrawable + xPixmap,
+					boxY1 + yDrawable + yPixmap),
+				pBand + (boxY1 - bandY) * width + (boxX1 - x1),
+				boxX2 - boxX1,
+				boxY2 - boxY1,
+				fPixmapDstPtr->pitchBytes,
+				width,
+				color);
+		}
+	}
+
+	free(pBand);
+
+	/* Damage does not wrap Trapezoids and Triangles, so report the */
+	/* pixels written behind its back (EPDC updates, Composite) */
+	BoxRec damageBox;
+	RegionRec damageRegion;
+
+	damageBox.x1 = x1 + xDrawable;
+	damageBox.y1 = y1 + yDrawable;
+	damageBox.x2 = x2 + xDrawable;
+	damageBox.y2 = y2 + yDrawable;
+	REGION_INIT(pScreen, &damageRegion, &damageBox, 1);
+	REGION_INTERSECT(pScreen, &damageRegion, &damageRegion, pClip);
+	DamageRegionAppend(pDst->pDrawable, &damageRegion);
+	DamageRegionProcessPending(pDst->pDrawable);
+	REGION_UNINIT(pScreen, &damageRegion);
+
+	return TRUE;
+}
+
+static void
+imxExaTrapezoids(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+			PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+			int ntrap, xTrapezoid* traps)
+{
+	ScreenPtr pScreen = pDst->pDrawable->pScreen;
+	PictureScreenPtr ps = GetPictureScreen(pScreen);
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+
+	if (imxExaRasterizeTraps(op, pSrc, pDst, maskFormat, 1 == ntrap,
+			ntrap, traps)) {
+		return;
+	}
+
+	ps->Trapezoids = fPtr->saveTrapezoids;
+	(*ps->Trapezoids)(op, pSrc, pDst, maskFormat, xSrc, ySrc, ntrap, traps);
+	fPtr->saveTrapezoids = ps->Trapezoids;
+	ps->Trapezoids = imxExaTrapezoids;
+}
+
+static void
+imxExaTriangles(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+			PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+			int ntri, xTriangle* tris)
+{
+	ScreenPtr pScreen = pDst->pDrawable->pScreen;
+	PictureScreenPtr ps = GetPictureScreen(pScreen);
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+	int i;
+
+	xTrapezoid* pTraps = malloc(2 * ntri * sizeof(xTrapezoid));
+	if (NULL != pTraps) {
+
+		int ntrap = 0;
+		for (i = 0; i < ntri; ++i) {
+			ntrap += imxExaTriangleToTraps(&tris[i], pTraps + ntrap);
+		}
+
+		const Bool done = imxExaRasterizeTraps(op, pSrc, pDst,
+					maskFormat, 1 == ntri, ntrap, pTraps);
+		free(pTraps);
+		if (done) {
+			return;
+		}
+	}
+
+	ps->Triangles = fPtr->saveTriangles;
+	(*ps->Triangles)(op, pSrc, pDst, maskFormat, xSrc, ySrc, ntri, tris);
+	fPtr->saveTriangles = ps->Triangles;
+	ps->Triangles = imxExaTriangles;
+}
+
+/* -------------------------------------------------------------------- */
+
+/*
+ * Physical address and pitch of a pixmap in frame buffer memory, for
+ * hardware blocks such as the IPU.  Returns FALSE for pixmaps elsewhere.
+ */
+Bool
+imxExaGetPixmapProperties(PixmapPtr pPixmap, void** pPhysAddr, int* pPitch)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pPixmap->drawable.pScreen);
+	if (NULL == fPtr) {
+		return FALSE;
+	}
+
+	ImxExaPixmapPtr fPixmapPtr = imxExaGetPixmapPrivate(pPixmap);
+	if ((NULL == fPixmapPtr) || (NULL == fPixmapPtr->ptr) ||
+		(0 == fPtr->fbPhysStart)) {
+		return FALSE;
+	}
+
+	/* The caller's hardware reads the pixels directly */
+	imxExaFlushUploads(fPtr);
+
+	/* Screen pixmap or pixmap in offscreen memory? */
+	const unsigned char* pMemoryStart =
+		(const unsigned char*)fPtr->exaDriverPtr->memoryBase;
+	if ((fPixmapPtr->ptr < pMemoryStart) ||
+		(fPixmapPtr->ptr >= pMemoryStart + fPtr->exaDriverPtr->memorySize)) {
+		return FALSE;
+	}
+
+	if (NULL != pPhysAddr) {
+		*pPhysAddr = (void*)(fPtr->fbPhysStart +
+					(fPixmapPtr->ptr - pMemoryStart));
+	}
+	if (NULL != pPitch) {
+		*pPitch = fPixmapPtr->pitchBytes;
+	}
+
+	return TRUE;
+}
+
+Bool
+imxExaSetup(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Private data structure must not already be in use. */
+	if (NULL != imxPtr->exaDriverPrivate) {
+		return FALSE;
+	}
+
+	/* Allocate memory for EXA private data */
+	imxPtr->exaDriverPrivate = calloc(sizeof(ImxExaRec), 1);
+	if (NULL == imxPtr->exaDriverPrivate) {
+		return FALSE;
+	}
+	ImxExaPtr fPtr = IMXEXAPTR(imxPtr);
+
+	/* Physical address of the frame buffer, for the IPU */
+	struct fb_fix_screeninfo fbFixScreenInfo;
+	int fdDev = fbdevHWGetFD(pScrn);
+	if ((-1 != fdDev) &&
+		(-1 != ioctl(fdDev, FBIOGET_FSCREENINFO, &fbFixScreenInfo))) {
+
+		fPtr->fbPhysStart = fbFixScreenInfo.smem_start;
+	}
+
+	ExaDriverPtr exaDriverPtr = exaDriverAlloc();
+	if (NULL == exaDriverPtr) {
+
+		free(imxPtr->exaDriverPrivate);
+		imxPtr->exaDriverPrivate = NULL;
+		return FALSE;
+	}
+	fPtr->exaDriverPtr = exaDriverPtr;
+
+	/* Frame buffer memory beyond the screen holds pixmaps */
+	exaDriverPtr->exa_major = EXA_VERSION_MAJOR;
+	exaDriverPtr->exa_minor = EXA_VERSION_MINOR;
+	exaDriverPtr->memoryBase = imxPtr->fbMemoryStart;
+	exaDriverPtr->memorySize = imxPtr->fbMemorySize;
+	exaDriverPtr->offScreenBase = imxPtr->fbMemoryScreenReserve;
+	exaDriverPtr->pixmapOffsetAlign = IMX_EXA_PIXMAP_ALIGN;
+	exaDriverPtr->pixmapPitchAlign = IMX_EXA_PIXMAP_ALIGN;
+	exaDriverPtr->maxX = IMX_EXA_MAX_WIDTH;
+	exaDriverPtr->maxY = IMX_EXA_MAX_HEIGHT;
+	exaDriverPtr->flags =
+		EXA_OFFSCREEN_PIXMAPS |
+		EXA_HANDLES_PIXMAPS |
+		EXA_SUPPORTS_PREPARE_AUX;
+
+	/* Pixmap management */
+	exaDriverPtr->CreatePixmap2 = imxExaCreatePixmap2;
+	exaDriverPtr->DestroyPixmap = imxExaDestroyPixmap;
+	exaDriverPtr->ModifyPixmapHeader = imxExaModifyPixmapHeader;
+	exaDriverPtr->PixmapIsOffscreen = imxExaPixmapIsOffscreen;
+	exaDriverPtr->PrepareAccess = imxExaPrepareAccess;
+	exaDriverPtr->FinishAccess = imxExaFinishAccess;
+
+	/* Synchronization */
+	exaDriverPtr->WaitMarker = imxExaWaitMarker;
+
+	/* Solid fill, copy and image transfer */
+	exaDriverPtr->PrepareSolid = imxExaPrepareSolid;
+	exaDriverPtr->Solid = imxExaSolid;
+	exaDriverPtr->DoneSolid = imxExaDoneSolid;
+	exaDriverPtr->PrepareCopy = imxExaPrepareCopy;
+	exaDriverPtr->Copy = imxExaCopy;
+	exaDriverPtr->DoneCopy = imxExaDoneCopy;
+	exaDriverPtr->UploadToScreen = imxExaUploadToScreen;
+	exaDriverPtr->DownloadFromScreen = imxExaDownloadFromScreen;
+
+	/* Render composite fast paths, the rest falls back to fb */
+	if (imxPtr->useAccelComposite) {
+
+		exaDriverPtr->CheckComposite = imxExaCheckComposite;
+		exaDriverPtr->PrepareComposite = imxExaPrepareComposite;
+		exaDriverPtr->Composite = imxExaComposite;
+		exaDriverPtr->DoneComposite = imxExaDoneComposite;
+	}
+
+	/* Worker threads are optional, operations run inline without */
+	fPtr->pool = imx_accel_pool_create(imxPtr->accelThreads);
+	if (NULL != fPtr->pool) {
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			"%d worker threads for large operations\n",
+			imx_accel_pool_threads(fPtr->pool));
+	}
+
+	/* Offscreen memory is optional, pixmaps fall back to system memory */
+	if (!imxExaOffscreenSetPolicy(pScreen, imxPtr->offscreenEviction)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unknown OffscreenEviction '%s', using default\n",
+			imxPtr->offscreenEviction);
+		imxExaOffscreenSetPolicy(pScreen, NULL);
+	}
+	if ((exaDriverPtr->offScreenBase < exaDriverPtr->memorySize) &&
+		!imxExaOffscreenInit(pScreen)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			"unable to manage offscreen frame buffer memory\n");
+		exaDriverPtr->offScreenBase = exaDriverPtr->memorySize;
+	}
+
+	/* Compaction when idle, wrapped inside EXA so that EXA has */
+	/* unwrapped its own by the time imxExaCloseScreen is called */
+	if (exaDriverPtr->offScreenBase < exaDriverPtr->memorySize) {
+
+		fPtr->saveBlockHandler = pScreen->BlockHandler;
+		pScreen->BlockHandler = imxExaBlockHandler;
+	}
+
+	if (!exaDriverInit(pScreen, exaDriverPtr)) {
+
+		xf86DrvMsg(pScrn->scrnIndex, X_ERROR, "exaDriverInit failed\n");
+		if (NULL != fPtr->saveBlockHandler) {
+			pScreen->BlockHandler = fPtr->saveBlockHandler;
+		}
+		imxExaOffscreenFini(pScreen);
+		imx_accel_pool_destroy(fPtr->pool);
+		free(exaDriverPtr);
+		free(imxPtr->exaDriverPrivate);
+		imxPtr->exaDriverPrivate = NULL;
+		return FALSE;
+	}
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		"%lu bytes of frame buffer memory for offscreen pixmaps\n",
+		exaDriverPtr->memorySize - exaDriverPtr->offScreenBase);
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		"offscreen eviction policy: %s\n",
+		imxExaOffscreenPolicyName(pScreen));
+	if (imxPtr->useAccelComposite) {
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			"Render composite fast paths in use\n");
+	}
+
+	/* Shapes rasterized in bands, wrapping what EXA installed */
+	PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+	if (imxPtr->useAccelComposite && (NULL != ps)) {
+
+		fPtr->saveTrapezoids = ps->Trapezoids;
+		ps->Trapezoids = imxExaTrapezoids;
+		fPtr->saveTriangles = ps->Triangles;
+		ps->Triangles = imxExaTriangles;
+	}
+
+	/* Text from the glyph atlas */
+	if (imxPtr->useAccelComposite && (NULL != ps) &&
+		(exaDriverPtr->offScreenBase < exaDriverPtr->memorySize)) {
+
+		imxExaGlyphsReset(fPtr);
+
+		fPtr->saveGlyphs = ps->Glyphs;
+		ps->Glyphs = imxExaGlyphs;
+		fPtr->saveUnrealizeGlyph = ps->UnrealizeGlyph;
+		ps->UnrealizeGlyph = imxExaUnrealizeGlyph;
+
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			"%d bytes of frame buffer memory for the glyph atlas\n",
+			IMX_EXA_GLYPH_ATLAS_SIZE);
+	}
+
+	return TRUE;
+}
+
+/* Called before the CloseScreen chain, while the Render screen private */
+/* still exists, so that EXA finds its own Render functions in place */
+/* when it unwraps them. */
+void
+imxExaUnwrapScreen(ScreenPtr pScreen)
+{
+	ImxExaPtr fPtr = imxExaGetScreenPrivate(pScreen);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+	if ((NULL != ps) && (NULL != fPtr->saveGlyphs)) {
+
+		ps->Glyphs = fPtr->saveGlyphs;
+		ps->UnrealizeGlyph = fPtr->saveUnrealizeGlyph;
+		fPtr->saveGlyphs = NULL;
+	}
+
+	if ((NULL != ps) && (NULL != fPtr->saveTrapezoids)) {
+
+		ps->Trapezoids = fPtr->saveTrapezoids;
+		ps->Triangles = fPtr->saveTriangles;
+		fPtr->saveTrapezoids = NULL;
+	}
+}
+
+void
+imxExaCloseScreen(ScreenPtr pScreen)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+
+	/* Access driver private screen data */
+	ImxPtr imxPtr = IMXPTR(pScrn);
+
+	/* Access EXA private screen data */
+	ImxExaPtr fPtr = IMXEXAPTR(imxPtr);
+	if (NULL == fPtr) {
+		return;
+	}
+
+	imxExaFlushUploads(fPtr);
+
+	exaDriverFini(pScreen);
+
+	/* For comparing eviction policies */
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		"offscreen eviction policy %s: %lu hits, %lu misses, "
+		"%lu evictions\n",
+		imxExaOffscreenPolicyName(pScreen), fPtr->offScreenHits,
+		fPtr->offScreenMisses, fPtr->offScreenEvictions);
+
+	if (NULL != fPtr->saveBlockHandler) {
+		pScreen->BlockHandler = fPtr->saveBlockHandler;
+	}
+
+	imxExaOffscreenFini(pScreen);
+	imx_accel_pool_destroy(fPtr->pool);
+	free(fPtr->exaDriverPtr);
+
+	free(imxPtr->exaDriverPrivate);
+	imxPtr->exaDriverPrivate = NULL;
+}
+
+#else
+
+Bool
+imxExaSetup(ScreenPtr pScreen)
+{
+	xf86DrvMsg(xf86ScreenToScrn(pScreen)->scrnIndex, X_WARNING,
+		"EXA 2.5 or newer required for acceleration\n");
+	return FALSE;
+}
+
+void
+imxExaUnwrapScreen(ScreenPtr pScreen)
+{
+}
+
+void
+imxExaCloseScreen(ScreenPtr pScreen)
+{
+}
+
+Bool
+imxExaGetPixmapProperties(PixmapPtr pPixmap, void** pPhysAddr, int* pPitch)
+{
+	return FALSE;
+}
+
+#endif
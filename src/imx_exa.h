@@ -27,6 +27,9 @@
 
 #include "xf86.h"
 #include "exa.h"
+#include "picturestr.h"
+#include "imx_accel.h"
+#include "imx_accel_pool.h"
 
 
 /* Macro converts the EXA_VERSION_* definitions for major, minor, and */
@@ -39,9 +42,79 @@
 						EXA_VERSION_RELEASE)
 
 
+/* Small uploads to frame buffer pixmaps are batched, up to this many */
+/* uploads and this many bytes of pixels */
+#define	IMX_EXA_UPLOAD_BATCH_MAX	64
+#define	IMX_EXA_UPLOAD_BATCH_BYTES	(16 * 1024)
+
+/* Free offscreen areas are kept in lists by size class, sizes from */
+/* 2^n to 2^(n+1)-1 bytes in class n */
+#define	IMX_EXA_OFFSCREEN_CLASSES	32
+
+/* Small offscreen allocations are slots carved out of slabs, one slab */
+/* size per slot size, and a 32 bit occupancy bitmap per slab */
+#define	IMX_EXA_SLAB_CLASSES		11
+#define	IMX_EXA_SLAB_SLOTS		32
+
+/* Glyph atlas cells, in two sizes, and buckets to find them by glyph */
+#define	IMX_EXA_GLYPH_CLASSES		2
+#define	IMX_EXA_GLYPH_ENTRIES		384
+#define	IMX_EXA_GLYPH_HASH_SIZE		256
+
 /* -------------------------------------------------------------------- */
 /* our private data, and two functions to allocate/free this            */
 
+struct _ImxExaPixmapRec;
+struct _ImxExaOffscreenAreaRec;
+struct _ImxExaOffscreenSlabRec;
+struct _ImxExaOffscreenChunkRec;
+struct _ImxExaOffscreenPolicyRec;
+
+/* Upload waiting in the batch */
+typedef struct {
+
+	struct _ImxExaPixmapRec*	fPixmapPtr;
+	int				x;
+	int				y;
+	int				width;
+	int				height;
+
+	/* Pixels in uploadBuffer, rows packed */
+	int				offset;
+	int				pitch;
+
+} ImxExaUploadRec, *ImxExaUploadPtr;
+
+/* Cell of the glyph atlas */
+typedef struct _ImxExaGlyphEntryRec {
+
+	/* Glyph in the cell, NULL if the cell is free */
+	GlyphPtr			pGlyph;
+	CARD32				format;
+
+	/* Next entry in the same hash bucket */
+	struct _ImxExaGlyphEntryRec*	pHashNext;
+
+	/* Least recently used order within the cell size */
+	struct _ImxExaGlyphEntryRec*	pLruPrev;
+	struct _ImxExaGlyphEntryRec*	pLruNext;
+
+	/* Offset of the cell in the atlas */
+	int				offset;
+
+	/* Run of glyphs last drawn from the cell */
+	unsigned			run;
+
+} ImxExaGlyphEntryRec, *ImxExaGlyphEntryPtr;
+
+/* Atlas cells of one size, least recently used after the list head */
+typedef struct {
+
+	int				cellSize;
+	ImxExaGlyphEntryRec		lru;
+
+} ImxExaGlyphClassRec, *ImxExaGlyphClassPtr;
+
 typedef struct {
 
 	/* This must be pointer allocated by calling exaDriverAlloc */
@@ -51,9 +124,156 @@ typedef struct {
 	ExaOffscreenArea*		offScreenAreas;
 	unsigned			offScreenCounter;
 	unsigned			numOffscreenAvailable;
+	struct _ImxExaOffscreenAreaRec*	offScreenFree[IMX_EXA_OFFSCREEN_CLASSES];
+	unsigned			offScreenFreeClasses;
+	struct _ImxExaOffscreenSlabRec*	offScreenSlabs[IMX_EXA_SLAB_CLASSES];
+	struct _ImxExaOffscreenChunkRec*	offScreenChunks;
+	struct _ImxExaOffscreenAreaRec*	offScreenSpare;
+
+	/* Set when an allocation had to evict while free offscreen */
+	/* memory was split, until compaction has done what it can */
+	Bool				offScreenFragmented;
+
+	/* Eviction policy, and how well it has done: uses of pixmaps */
+	/* in offscreen memory and of pixmaps evicted from it, and */
+	/* allocations evicted */
+	const struct _ImxExaOffscreenPolicyRec*	offScreenPolicy;
+	unsigned long			offScreenHits;
+	unsigned long			offScreenMisses;
+	unsigned long			offScreenEvictions;
+
+	/* Screen function wrapped to compact while idle */
+	ScreenBlockHandlerProcPtr	saveBlockHandler;
+
+	/* Worker threads for large operations, NULL to run inline */
+	ImxAccelPoolPtr			pool;
+
+	/* Physical address of the start of frame buffer memory */
+	unsigned long			fbPhysStart;
+
+	/* Solid fill set up by PrepareSolid */
+	imx_fill_sw_func		solidFunc;
+	uint32_t			solidColor;
+
+	/* Copy set up by PrepareCopy; the overlap kernel is for */
+	/* rectangles that overlap within one pixmap */
+	imx_copy_sw_no_overlap_func	copyFunc;
+	imx_copy_sw_overlap_func	copyOverlapFunc;
+	PixmapPtr			pCopySrc;
+
+	/* Composite set up by PrepareComposite; the operation is one */
+	/* of the IMX_EXA_COMPOSITE_* fast paths in imx_exa.c */
+	int				compositeOp;
+	uint32_t			compositeColor;
+	PixmapPtr			pCompositeSrc;
+	PixmapPtr			pCompositeMask;
+
+	/* Batched uploads, written to the pixmaps before anything */
+	/* else can see them */
+	int				numUploads;
+	int				uploadBufferUsed;
+	ImxExaUploadRec			uploads[IMX_EXA_UPLOAD_BATCH_MAX];
+	unsigned char			uploadBuffer[IMX_EXA_UPLOAD_BATCH_BYTES]
+						__attribute__((aligned(16)));
+
+	/* Glyph atlas in offscreen memory, NULL until first used or */
+	/* after being evicted */
+	ExaOffscreenArea*		pGlyphArea;
+	unsigned			glyphRun;
+	ImxExaGlyphClassRec		glyphClasses[IMX_EXA_GLYPH_CLASSES];
+	ImxExaGlyphEntryRec		glyphEntries[IMX_EXA_GLYPH_ENTRIES];
+	ImxExaGlyphEntryPtr		glyphHash[IMX_EXA_GLYPH_HASH_SIZE];
+	GlyphsProcPtr			saveGlyphs;
+	UnrealizeGlyphProcPtr		saveUnrealizeGlyph;
+
+	/* Render functions wrapped for shapes */
+	TrapezoidsProcPtr		saveTrapezoids;
+	TrianglesProcPtr		saveTriangles;
 
 } ImxExaRec, *ImxExaPtr;
 
 #define IMXEXAPTR(imxPtr) ((ImxExaPtr)((imxPtr)->exaDriverPrivate))
 
+/* Driver private data for each pixmap */
+typedef struct _ImxExaPixmapRec {
+
+	/* Pixmap properties from the last ModifyPixmapHeader */
+	int				width;
+	int				height;
+	int				bitsPerPixel;
+	int				pitchBytes;
+
+	/* Pixels of the pixmap, NULL if it has none yet */
+	unsigned char*			ptr;
+
+	/* Frame buffer memory holding the pixels, NULL if elsewhere */
+	ExaOffscreenArea*		pArea;
+
+	/* System memory holding the pixels if owned by the pixmap */
+	unsigned char*			pSysMem;
+
+	/* Number of PrepareAccess calls not yet finished */
+	int				accessCount;
+
+	/* Pixels were moved out of frame buffer memory to make room */
+	Bool				evicted;
+
+} ImxExaPixmapRec, *ImxExaPixmapPtr;
+
+/* -------------------------------------------------------------------- */
+
+extern Bool
+imxExaSetup(ScreenPtr pScreen);
+
+extern void
+imxExaUnwrapScreen(ScreenPtr pScreen);
+
+extern void
+imxExaCloseScreen(ScreenPtr pScreen);
+
+extern Bool
+imxExaGetPixmapProperties(PixmapPtr pPixmap, void** pPhysAddr, int* pPitch);
+
+/* Offscreen frame buffer memory manager in imx_exa_offscreen.c */
+extern ExaOffscreenArea*
+imxExaOffscreenAlloc(ScreenPtr pScreen, int size, int align, Bool locked,
+			ExaOffscreenSaveProc save, pointer privData);
+
+extern ExaOffscreenArea*
+imxExaOffscreenFree(ScreenPtr pScreen, ExaOffscreenArea* area);
+
+extern Bool
+imxExaOffscreenInit(ScreenPtr pScreen);
+
+extern void
+imxExaOffscreenFini(ScreenPtr pScreen);
+
+extern void
+imxExaOffscreenSwapIn(ScreenPtr pScreen);
+
+extern void
+imxExaOffscreenSwapOut(ScreenPtr pScreen);
+
+extern void
+imxExaOffscreenMarkUsed(ImxExaPtr imxExaPtr, ExaOffscreenArea* area);
+
+/* For save callbacks that could not save; the area is not evicted */
+extern void
+imxExaOffscreenSaveFailed(ExaOffscreenArea* area);
+
+/* Eviction policy by name, NULL for the default; FALSE if unknown */
+extern Bool
+imxExaOffscreenSetPolicy(ScreenPtr pScreen, const char* name);
+
+extern const char*
+imxExaOffscreenPolicyName(ScreenPtr pScreen);
+
+/* Called for each area that compaction moved, with its new offset */
+typedef void (*ImxExaOffscreenMoveProc)(ScreenPtr pScreen,
+					ExaOffscreenArea* pArea);
+
+extern Bool
+imxExaOffscreenCompact(ScreenPtr pScreen, ImxExaOffscreenMoveProc move,
+			CARD32 deadline);
+
 #endif
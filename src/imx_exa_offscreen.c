@@ -50,8 +50,19 @@
 
 /** @file
  * This allocator allocates blocks of memory by maintaining a list of areas.
- * When allocating, the contiguous block of areas with the minimum eviction
- * cost is found and evicted in order to make room for the new allocation.
+ * Free areas are also kept in offset order in lists by power of two size
+ * class, so that allocations find the first space that fits without
+ * walking every area.  When nothing fits, the contiguous block of areas
+ * with the minimum eviction cost is found and evicted in order to make room
+ * for the new allocation.
+ *
+ * Small allocations do not get areas of their own.  They take a slot in
+ * a slab, an area holding IMX_EXA_SLAB_SLOTS slots of one size, and the
+ * whole slab is evicted when its area is.
+ *
+ * What eviction costs is up to a policy, chosen by name: "frequency"
+ * weighs how often an area has been used as well as how recently, and
+ * "age" only the time since its last use.
  */
 #include <xorg-server.h>
 
@@ -63,6 +74,7 @@
 #include <limits.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if (IMX_EXA_VERSION_COMPILED >= IMX_EXA_VERSION(2,5,0))
 
@@ -74,6 +86,91 @@
 #define DBG_OFFSCREEN(a)
 #endif
 
+/* area record with the links of its size class free list */
+typedef struct _ImxExaOffscreenAreaRec {
+    ExaOffscreenArea			area;
+    struct _ImxExaOffscreenAreaRec	*freePrev;
+    struct _ImxExaOffscreenAreaRec	*freeNext;
+    /* slab holding the area if it is a slot, else NULL */
+    struct _ImxExaOffscreenSlabRec	*slab;
+    /* uses counted by the eviction policy, and when last counted */
+    unsigned				uses;
+    unsigned				counted;
+    /* set by the save callback when the contents could not be saved */
+    Bool				saveFailed;
+} ImxExaOffscreenAreaRec, *ImxExaOffscreenAreaPtr;
+
+#define IMX_EXA_AREA(a)	((ImxExaOffscreenAreaPtr) (a))
+
+/*
+ * area records come from chunks released only by imxExaOffscreenFini,
+ * the first with a record for every IMX_EXA_AREA_GRANULE bytes of
+ * offscreen memory, then IMX_EXA_AREA_CHUNK records at a time
+ */
+#define IMX_EXA_AREA_GRANULE	(16 * 1024)
+#define IMX_EXA_AREA_CHUNK	64
+
+typedef struct _ImxExaOffscreenChunkRec {
+    struct _ImxExaOffscreenChunkRec	*next;
+    ImxExaOffscreenAreaRec		recs[];
+} ImxExaOffscreenChunkRec, *ImxExaOffscreenChunkPtr;
+
+/* slab of equal slots, kept in a single area of the list */
+typedef struct _ImxExaOffscreenSlabRec {
+    ExaOffscreenArea			*area;
+    int					slotClass;
+    int					slotSize;
+    /* bit n set when slot n is allocated */
+    uint32_t				used;
+    /* links of the list of slabs with free slots */
+    struct _ImxExaOffscreenSlabRec	*prev;
+    struct _ImxExaOffscreenSlabRec	*next;
+    ImxExaOffscreenAreaRec		slots[IMX_EXA_SLAB_SLOTS];
+} ImxExaOffscreenSlabRec, *ImxExaOffscreenSlabPtr;
+
+/* slot sizes, each a multiple of the slab alignment */
+#define IMX_EXA_SLAB_ALIGN	32
+
+/*
+ * largest area compaction moves, as one move cannot be interrupted: the
+ * deadline is only checked between moves, so this has to copy within the
+ * 2 ms idle budget even from uncached frame buffer memory (64 MB/s)
+ */
+#define IMX_EXA_COMPACT_MOVE_MAX	(128 * 1024)
+
+static const int imxExaSlabSlotSizes[IMX_EXA_SLAB_CLASSES] = {
+    64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+static void
+imxExaOffscreenSlabSave (ScreenPtr pScreen, ExaOffscreenArea *area);
+
+/* eviction policy: notes each use of an area, and prices evicting it */
+typedef struct _ImxExaOffscreenPolicyRec {
+    const char	*name;
+    void	(*used) (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter);
+    unsigned	(*cost) (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter);
+} ImxExaOffscreenPolicyRec;
+
+/*
+ * frequency policy, after 2Q: uses closer together than
+ * IMX_EXA_FREQ_CORRELATED count once, as when drawing one frame, so an
+ * area has to be used again later to be worth more than a new one.
+ * Counts halve every IMX_EXA_FREQ_HALF_LIFE, and evicting costs the
+ * bytes to save plus IMX_EXA_FREQ_SAVE_BYTES for each count.
+ */
+#define IMX_EXA_FREQ_CORRELATED	256
+#define IMX_EXA_FREQ_HALF_LIFE	16384
+#define IMX_EXA_FREQ_MAX	7
+#define IMX_EXA_FREQ_SAVE_BYTES	4096
+
+/* size class of an area: n for sizes from 2^n to 2^(n+1)-1 */
+static int
+imxExaOffscreenSizeClass (int size)
+{
+    return 31 - __builtin_clz (size);
+}
+
 #if DEBUG_OFFSCREEN
 static void
 imxExaOffscreenValidate (ScreenPtr pScreen)
@@ -83,6 +180,9 @@ imxExaOffscreenValidate (ScreenPtr pScreen)
     ImxPtr imxPtr = IMXPTR(pScrn);
     ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
     ExaOffscreenArea *prev = 0, *area;
+    ImxExaOffscreenAreaPtr rec;
+    unsigned numFree = 0;
+    int sizeClass;
 
     assert (imxExaPtr->offScreenAreas->base_offset == 
 	    imxExaPtr->exaDriverPtr->offScreenBase);
@@ -95,12 +195,183 @@ imxExaOffscreenValidate (ScreenPtr pScreen)
 	prev = area;
     }
     assert (prev->base_offset + prev->size == imxExaPtr->exaDriverPtr->memorySize);
+
+    /* all slots fit in their slab; a slab being set up has no slots and */
+    /* does not know its area yet */
+    for (area = imxExaPtr->offScreenAreas; area; area = area->next)
+    {
+	ImxExaOffscreenSlabPtr slab;
+
+	if (area->state == ExaOffscreenAvail ||
+	    area->save != imxExaOffscreenSlabSave)
+	    continue;
+
+	slab = area->privData;
+	assert (slab->area == area || (!slab->area && !slab->used));
+	assert (IMX_EXA_SLAB_SLOTS * slab->slotSize <= area->size);
+    }
+
+    /* every free area is on the list of its size class */
+    for (sizeClass = 0; sizeClass < IMX_EXA_OFFSCREEN_CLASSES; sizeClass++)
+    {
+	for (rec = imxExaPtr->offScreenFree[sizeClass]; rec; rec = rec->freeNext)
+	{
+	    assert (rec->area.state == ExaOffscreenAvail);
+	    assert (imxExaOffscreenSizeClass (rec->area.size) == sizeClass);
+	    assert (!rec->freeNext ||
+		    rec->area.base_offset < rec->freeNext->area.base_offset);
+	    numFree++;
+	}
+    }
+    assert (numFree == imxExaPtr->numOffscreenAvailable);
 }
 #else
 #define imxExaOffscreenValidate(s)
 #endif
 
-/* merge the next free area into this one */
+/* add a chunk of area records to the spare ones */
+static Bool
+imxExaOffscreenGrowRecs (ImxExaPtr imxExaPtr, int count)
+{
+    ImxExaOffscreenChunkPtr chunk;
+    int i;
+
+    chunk = malloc (sizeof (ImxExaOffscreenChunkRec) +
+		    count * sizeof (ImxExaOffscreenAreaRec));
+    if (!chunk)
+	return FALSE;
+
+    chunk->next = imxExaPtr->offScreenChunks;
+    imxExaPtr->offScreenChunks = chunk;
+
+    /* spare records are linked through their free list link */
+    for (i = 0; i < count; i++)
+    {
+	chunk->recs[i].freeNext = imxExaPtr->offScreenSpare;
+	imxExaPtr->offScreenSpare = &chunk->recs[i];
+    }
+
+    return TRUE;
+}
+
+static ExaOffscreenArea *
+imxExaOffscreenAllocRec (ImxExaPtr imxExaPtr)
+{
+    ImxExaOffscreenAreaPtr rec;
+
+    if (!imxExaPtr->offScreenSpare &&
+	!imxExaOffscreenGrowRecs (imxExaPtr, IMX_EXA_AREA_CHUNK))
+	return NULL;
+
+    rec = imxExaPtr->offScreenSpare;
+    imxExaPtr->offScreenSpare = rec->freeNext;
+    rec->slab = NULL;
+
+    return &rec->area;
+}
+
+static void
+imxExaOffscreenFreeRec (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
+{
+    ImxExaOffscreenAreaPtr rec = IMX_EXA_AREA (area);
+
+    rec->freeNext = imxExaPtr->offScreenSpare;
+    imxExaPtr->offScreenSpare = rec;
+}
+
+/* add a free area to the list of its size class, in offset order */
+static void
+imxExaOffscreenFreeListAdd (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
+{
+    ImxExaOffscreenAreaPtr rec = IMX_EXA_AREA (area);
+    int sizeClass = imxExaOffscreenSizeClass (area->size);
+    ImxExaOffscreenAreaPtr prev = NULL;
+    ImxExaOffscreenAreaPtr next = imxExaPtr->offScreenFree[sizeClass];
+
+    while (next && next->area.base_offset < area->base_offset)
+    {
+	prev = next;
+	next = next->freeNext;
+    }
+
+    rec->freePrev = prev;
+    rec->freeNext = next;
+    if (prev)
+	prev->freeNext = rec;
+    else
+	imxExaPtr->offScreenFree[sizeClass] = rec;
+    if (next)
+	next->freePrev = rec;
+    imxExaPtr->offScreenFreeClasses |= 1U << sizeClass;
+}
+
+/* take a free area off its list; its size must not have changed since */
+static void
+imxExaOffscreenFreeListRemove (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
+{
+    ImxExaOffscreenAreaPtr rec = IMX_EXA_AREA (area);
+    int sizeClass = imxExaOffscreenSizeClass (area->size);
+
+    if (rec->freePrev)
+	rec->freePrev->freeNext = rec->freeNext;
+    else
+	imxExaPtr->offScreenFree[sizeClass] = rec->freeNext;
+    if (rec->freeNext)
+	rec->freeNext->freePrev = rec->freePrev;
+
+    if (!imxExaPtr->offScreenFree[sizeClass])
+	imxExaPtr->offScreenFreeClasses &= ~(1U << sizeClass);
+}
+
+/* does the allocation fit in the free area, counting alignment loss? */
+static Bool
+imxExaOffscreenFits (ExaOffscreenArea *area, int size, int align)
+{
+    return size + (area->base_offset + area->size - size) % align <= area->size;
+}
+
+/*
+ * find the free area with the lowest offset the allocation fits in, as
+ * walking every area would: the lists are in offset order, so only the
+ * own size class needs searching, and larger classes offer their first
+ * fitting area.
+ */
+static ExaOffscreenArea *
+imxExaOffscreenFindFree (ImxExaPtr imxExaPtr, int size, int align)
+{
+    int sizeClass = imxExaOffscreenSizeClass (size);
+    ImxExaOffscreenAreaPtr rec, best = NULL;
+    unsigned classes;
+
+    for (rec = imxExaPtr->offScreenFree[sizeClass]; rec; rec = rec->freeNext)
+    {
+	if (imxExaOffscreenFits (&rec->area, size, align))
+	{
+	    best = rec;
+	    break;
+	}
+    }
+
+    classes = imxExaPtr->offScreenFreeClasses & ~((2U << sizeClass) - 1);
+    for (; classes; classes &= classes - 1)
+    {
+	/* only the alignment loss can stop an area of a larger class */
+	/* from fitting */
+	for (rec = imxExaPtr->offScreenFree[__builtin_ctz (classes)]; rec;
+	     rec = rec->freeNext)
+	{
+	    if (imxExaOffscreenFits (&rec->area, size, align))
+		break;
+	}
+
+	if (rec && (!best || rec->area.base_offset < best->area.base_offset))
+	    best = rec;
+    }
+
+    return best ? &best->area : NULL;
+}
+
+/* merge the next free area into this one; neither is on a free list */
 static void
 imxExaOffscreenMerge (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
 {
@@ -114,11 +385,220 @@ imxExaOffscreenMerge (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
 	area->next->prev = area;
     else
 	imxExaPtr->offScreenAreas->prev = area;
-    free (next);
+    imxExaOffscreenFreeRec (imxExaPtr, next);
 
     imxExaPtr->numOffscreenAvailable--;
 }
 
+/* -------------------------------------------------------------------- */
+
+/* slot class for an allocation, or -1 if it needs an area of its own */
+static int
+imxExaOffscreenSlabClass (int size, int align)
+{
+    int slotClass;
+
+    if (IMX_EXA_SLAB_ALIGN % align)
+	return -1;
+
+    for (slotClass = 0; slotClass < IMX_EXA_SLAB_CLASSES; slotClass++)
+    {
+	if (size <= imxExaSlabSlotSizes[slotClass])
+	    return slotClass;
+    }
+
+    return -1;
+}
+
+/* add a slab to the list of slabs with free slots of its class */
+static void
+imxExaOffscreenSlabLink (ImxExaPtr imxExaPtr, ImxExaOffscreenSlabPtr slab)
+{
+    slab->prev = NULL;
+    slab->next = imxExaPtr->offScreenSlabs[slab->slotClass];
+    if (slab->next)
+	slab->next->prev = slab;
+    imxExaPtr->offScreenSlabs[slab->slotClass] = slab;
+}
+
+static void
+imxExaOffscreenSlabUnlink (ImxExaPtr imxExaPtr, ImxExaOffscreenSlabPtr slab)
+{
+    if (slab->prev)
+	slab->prev->next = slab->next;
+    else
+	imxExaPtr->offScreenSlabs[slab->slotClass] = slab->next;
+    if (slab->next)
+	slab->next->prev = slab->prev;
+}
+
+/*
+ * slab area is about to be evicted, so are all of its slots; slots that
+ * cannot be saved keep the slab, and with it the area
+ */
+static void
+imxExaOffscreenSlabSave (ScreenPtr pScreen, ExaOffscreenArea *area)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    ImxPtr imxPtr = IMXPTR(pScrn);
+    ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
+    ImxExaOffscreenSlabPtr slab = area->privData;
+    Bool full = !~slab->used;
+    uint32_t used;
+
+    for (used = slab->used; used; used &= used - 1)
+    {
+	int i = __builtin_ctz (used);
+	ExaOffscreenArea *slot = &slab->slots[i].area;
+
+	slab->slots[i].saveFailed = FALSE;
+	if (slot->save)
+	{
+	    (*slot->save) (pScreen, slot);
+	    if (slab->slots[i].saveFailed)
+		continue;
+	    imxExaPtr->offScreenEvictions++;
+	}
+
+	slot->state = ExaOffscreenAvail;
+	slot->save = NULL;
+	slab->used &= ~(1U << i);
+    }
+
+    if (slab->used)
+    {
+	if (full && ~slab->used)
+	    imxExaOffscreenSlabLink (imxExaPtr, slab);
+	imxExaOffscreenSaveFailed (area);
+	return;
+    }
+
+    if (!full)
+	imxExaOffscreenSlabUnlink (imxExaPtr, slab);
+    free (slab);
+
+    /* the area no longer holds a slab */
+    area->save = NULL;
+    area->privData = NULL;
+}
+
+/*
+ * slots are locked and used without the slab knowing, so bring the state
+ * and last use of slab areas up to date before choosing what to evict
+ */
+static void
+imxExaOffscreenSlabSync (ImxExaPtr imxExaPtr)
+{
+    ExaOffscreenArea *area;
+
+    for (area = imxExaPtr->offScreenAreas; area; area = area->next)
+    {
+	ImxExaOffscreenSlabPtr slab;
+	uint32_t used;
+
+	if (area->state == ExaOffscreenAvail ||
+	    area->save != imxExaOffscreenSlabSave)
+	    continue;
+
+	slab = area->privData;
+	area->state = ExaOffscreenRemovable;
+	for (used = slab->used; used; used &= used - 1)
+	{
+	    ExaOffscreenArea *slot = &slab->slots[__builtin_ctz (used)].area;
+
+	    if (slot->state == ExaOffscreenLocked)
+		area->state = ExaOffscreenLocked;
+	    if ((int) (slot->last_use - area->last_use) > 0)
+		area->last_use = slot->last_use;
+	}
+    }
+}
+
+/* take a slot of the class, from a new slab if none has one free */
+static ExaOffscreenArea *
+imxExaOffscreenSlabAlloc (ScreenPtr pScreen, ImxExaPtr imxExaPtr,
+			  int slotClass, Bool locked,
+			  ExaOffscreenSaveProc save, pointer privData)
+{
+    ImxExaOffscreenSlabPtr slab = imxExaPtr->offScreenSlabs[slotClass];
+    ExaOffscreenArea *slot;
+    int i;
+
+    if (!slab)
+    {
+	slab = calloc (1, sizeof (ImxExaOffscreenSlabRec));
+	if (!slab)
+	    return NULL;
+
+	slab->slotClass = slotClass;
+	slab->slotSize = imxExaSlabSlotSizes[slotClass];
+	slab->area = imxExaOffscreenAlloc (pScreen,
+					   IMX_EXA_SLAB_SLOTS * slab->slotSize,
+					   IMX_EXA_SLAB_ALIGN, FALSE,
+					   imxExaOffscreenSlabSave, slab);
+	if (!slab->area)
+	{
+	    free (slab);
+	    return NULL;
+	}
+
+	imxExaOffscreenSlabLink (imxExaPtr, slab);
+    }
+
+    i = __builtin_ctz (~slab->used);
+    slab->used |= 1U << i;
+    if (!~slab->used)
+	imxExaOffscreenSlabUnlink (imxExaPtr, slab);
+
+    slab->slots[i].slab = slab;
+    slot = &slab->slots[i].area;
+    slot->base_offset = slab->area->offset + i * slab->slotSize;
+    slot->offset = slot->base_offset;
+    slot->size = slab->slotSize;
+    slot->align = IMX_EXA_SLAB_ALIGN;
+    slot->state = locked ? ExaOffscreenLocked : ExaOffscreenRemovable;
+    slot->privData = privData;
+    slot->save = save;
+    slot->last_use = imxExaPtr->offScreenCounter++;
+    slot->eviction_cost = 0;
+    slab->slots[i].uses = 0;
+    slab->slots[i].counted = slot->last_use;
+    slot->next = NULL;
+    slot->prev = NULL;
+
+    slab->area->last_use = slot->last_use;
+
+    DBG_OFFSCREEN (("Slot (%d) 0x%x -> 0x%x\n", slot->last_use,
+		    slot->size, slot->offset));
+    return slot;
+}
+
+/* give a slot back, and the slab with it if that was its last slot */
+static void
+imxExaOffscreenSlabFree (ScreenPtr pScreen, ImxExaPtr imxExaPtr,
+			 ExaOffscreenArea *slot)
+{
+    ImxExaOffscreenSlabPtr slab = IMX_EXA_AREA (slot)->slab;
+    int i = IMX_EXA_AREA (slot) - slab->slots;
+
+    DBG_OFFSCREEN (("Slot freed 0x%x -> 0x%x\n", slot->size, slot->offset));
+
+    slot->state = ExaOffscreenAvail;
+    slot->save = NULL;
+    slot->last_use = 0;
+
+    if (!~slab->used)
+	imxExaOffscreenSlabLink (imxExaPtr, slab);
+    slab->used &= ~(1U << i);
+
+    if (!slab->used)
+    {
+	imxExaOffscreenSlabUnlink (imxExaPtr, slab);
+	imxExaOffscreenFree (pScreen, slab->area);
+	free (slab);
+    }
+}
+
 /**
  * imxExaOffscreenFree frees an allocation.
  *
@@ -141,6 +621,12 @@ imxExaOffscreenFree (ScreenPtr pScreen, ExaOffscreenArea *area)
     ExaOffscreenArea	*next = area->next;
     ExaOffscreenArea	*prev;
 
+    if (IMX_EXA_AREA (area)->slab)
+    {
+	imxExaOffscreenSlabFree (pScreen, imxExaPtr, area);
+	return area;
+    }
+
     DBG_OFFSCREEN (("Freed (%u) 0x%x -> 0x%x (0x%x)\n", area->last_use,
                     area->size, area->base_offset, area->offset));
     imxExaOffscreenValidate (pScreen);
@@ -161,36 +647,63 @@ imxExaOffscreenFree (ScreenPtr pScreen, ExaOffscreenArea *area)
 
     /* link with next area if free */
     if (next && next->state == ExaOffscreenAvail)
+    {
+	imxExaOffscreenFreeListRemove (imxExaPtr, next);
 	imxExaOffscreenMerge (imxExaPtr, area);
+    }
 
     /* link with prev area if free */
     if (prev && prev->state == ExaOffscreenAvail)
     {
 	area = prev;
+	imxExaOffscreenFreeListRemove (imxExaPtr, area);
 	imxExaOffscreenMerge (imxExaPtr, area);
     }
 
+    imxExaOffscreenFreeListAdd (imxExaPtr, area);
+
     imxExaOffscreenValidate (pScreen);
     return area;
 }
 
+/**
+ * imxExaOffscreenSaveFailed is called by a save callback that could not
+ * save the contents of the area.  The area is then not evicted, and the
+ * allocation that wanted its space fails.
+ */
+void
+imxExaOffscreenSaveFailed (ExaOffscreenArea *area)
+{
+    IMX_EXA_AREA (area)->saveFailed = TRUE;
+}
+
+/* evict the area; NULL, with the area left alone, if it was not saved */
 static ExaOffscreenArea *
 imxExaOffscreenKickOut (ScreenPtr pScreen, ExaOffscreenArea *area)
 {
-    if (area->save)
-	(*area->save) (pScreen, area);
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    ImxPtr imxPtr = IMXPTR(pScrn);
+    ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
+    ExaOffscreenSaveProc save = area->save;
+
+    IMX_EXA_AREA (area)->saveFailed = FALSE;
+    if (save)
+	(*save) (pScreen, area);
+    if (IMX_EXA_AREA (area)->saveFailed)
+	return NULL;
+
+    /* slabs count their slots */
+    if (save && save != imxExaOffscreenSlabSave)
+	imxExaPtr->offScreenEvictions++;
+
     return imxExaOffscreenFree (pScreen, area);
 }
 
-static void
-imxExaUpdateEvictionCost(ExaOffscreenArea *area, unsigned offScreenCounter)
+/* time since the area was last used */
+static unsigned
+imxExaOffscreenAge (ExaOffscreenArea *area, unsigned offScreenCounter)
 {
-    unsigned age;
-
-    if (area->state == ExaOffscreenAvail)
-	return;
-
-    age = offScreenCounter - area->last_use;
+    unsigned age = offScreenCounter - area->last_use;
 
     /* This is unlikely to happen, but could result in a division by zero... */
     if (age > (UINT_MAX / 2)) {
@@ -198,17 +711,97 @@ imxExaUpdateEvictionCost(ExaOffscreenArea *area, unsigned offScreenCounter)
 	area->last_use = offScreenCounter - age;
     }
 
-    area->eviction_cost = area->size / age;
+    return age;
+}
+
+static void
+imxExaAgeUsed (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter)
+{
+}
+
+static unsigned
+imxExaAgeCost (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter)
+{
+    return rec->area.size / imxExaOffscreenAge (&rec->area, offScreenCounter);
+}
+
+/* use count after halving for the time since it was last counted */
+static unsigned
+imxExaFrequencyUses (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter)
+{
+    unsigned halvings = (offScreenCounter - rec->counted) /
+			IMX_EXA_FREQ_HALF_LIFE;
+
+    return halvings < 32 ? rec->uses >> halvings : 0;
+}
+
+static void
+imxExaFrequencyUsed (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter)
+{
+    unsigned uses;
+
+    if (offScreenCounter - rec->counted < IMX_EXA_FREQ_CORRELATED)
+	return;
+
+    uses = imxExaFrequencyUses (rec, offScreenCounter);
+    rec->uses = uses < IMX_EXA_FREQ_MAX ? uses + 1 : uses;
+    rec->counted = offScreenCounter;
+}
+
+static unsigned
+imxExaFrequencyCost (ImxExaOffscreenAreaPtr rec, unsigned offScreenCounter)
+{
+    uint64_t cost;
+
+    cost = (rec->area.size +
+	    (uint64_t) IMX_EXA_FREQ_SAVE_BYTES *
+	    imxExaFrequencyUses (rec, offScreenCounter)) /
+	   imxExaOffscreenAge (&rec->area, offScreenCounter);
+
+    return cost < UINT_MAX ? cost : UINT_MAX;
+}
+
+/* the first is the default */
+static const ImxExaOffscreenPolicyRec imxExaOffscreenPolicies[] = {
+    { "frequency", imxExaFrequencyUsed, imxExaFrequencyCost },
+    { "age", imxExaAgeUsed, imxExaAgeCost },
+};
+
+/* price evicting an area, or a slab with all of its slots */
+static void
+imxExaUpdateEvictionCost(ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
+{
+    const ImxExaOffscreenPolicyRec *policy = imxExaPtr->offScreenPolicy;
+    unsigned offScreenCounter = imxExaPtr->offScreenCounter;
+
+    if (area->state == ExaOffscreenAvail)
+	return;
+
+    if (area->save == imxExaOffscreenSlabSave)
+    {
+	ImxExaOffscreenSlabPtr slab = area->privData;
+	uint64_t cost = 0;
+	uint32_t used;
+
+	for (used = slab->used; used; used &= used - 1)
+	    cost += (*policy->cost) (&slab->slots[__builtin_ctz (used)],
+				     offScreenCounter);
+
+	area->eviction_cost = cost < UINT_MAX ? cost : UINT_MAX;
+    }
+    else
+	area->eviction_cost = (*policy->cost) (IMX_EXA_AREA (area),
+					       offScreenCounter);
 }
 
 static ExaOffscreenArea *
 imxExaFindAreaToEvict(ImxExaPtr imxExaPtr, int size, int align)
 {
     ExaOffscreenArea *begin, *end, *best;
-    unsigned cost, best_cost;
+    uint64_t cost, best_cost;
     int avail, real_size;
 
-    best_cost = UINT_MAX;
+    best_cost = UINT64_MAX;
     begin = end = imxExaPtr->offScreenAreas;
     avail = 0;
     cost = 0;
@@ -236,7 +829,7 @@ imxExaFindAreaToEvict(ImxExaPtr imxExaPtr, int size, int align)
 		goto restart;
 	    }
 	    avail += end->size;
-	    imxExaUpdateEvictionCost(end, imxExaPtr->offScreenCounter);
+	    imxExaUpdateEvictionCost(imxExaPtr, end);
 	    cost += end->eviction_cost;
 	    end = end->next;
 	}
@@ -284,7 +877,8 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
     ImxPtr imxPtr = IMXPTR(pScrn);
     ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
-    int real_size = 0, largest_avail = 0;
+    int real_size = 0;
+    int slotClass;
 
     imxExaOffscreenValidate (pScreen);
     if (!align)
@@ -305,26 +899,35 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
 	return NULL;
     }
 
-    /* Try to find a free space that'll fit. */
-    for (area = imxExaPtr->offScreenAreas; area; area = area->next)
+    /* Small requests take a slot, or an area if no slab can be had; */
+    /* slabs themselves always take an area */
+    slotClass = save == imxExaOffscreenSlabSave ? -1 :
+		imxExaOffscreenSlabClass (size, align);
+    if (slotClass >= 0)
     {
-	/* skip allocated areas */
-	if (area->state != ExaOffscreenAvail)
-	    continue;
+	area = imxExaOffscreenSlabAlloc (pScreen, imxExaPtr, slotClass,
+					 locked, save, privData);
+	if (area)
+	{
+	    imxExaOffscreenValidate (pScreen);
+	    return area;
+	}
+    }
 
+    /* Try to find a free space that'll fit. */
+    area = imxExaOffscreenFindFree (imxExaPtr, size, align);
+    if (area)
+    {
 	/* adjust size to match alignment requirement */
 	real_size = size + (area->base_offset + area->size - size) % align;
-
-	/* does it fit? */
-	if (real_size <= area->size)
-	    break;
-
-	if (area->size > largest_avail)
-	    largest_avail = area->size;
     }
-
-    if (!area)
+    else
     {
+	/* compaction might have avoided this */
+	if (imxExaPtr->numOffscreenAvailable > 1)
+	    imxExaPtr->offScreenFragmented = TRUE;
+
+	imxExaOffscreenSlabSync (imxExaPtr);
 	area = imxExaFindAreaToEvict(imxExaPtr, size, align);
 
 	if (!area)
@@ -346,19 +949,29 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
 	/*
 	 * Now get the system to merge the other needed areas together
 	 */
-	while (area->size < real_size)
+	while (area && area->size < real_size)
 	{
 	    assert (area->next && area->next->state == ExaOffscreenRemovable);
-	    (void) imxExaOffscreenKickOut (pScreen, area->next);
+	    if (!imxExaOffscreenKickOut (pScreen, area->next))
+		area = NULL;
+	}
+
+	/* an owner could not save its contents, so nothing was made room for */
+	if (!area)
+	{
+	    DBG_OFFSCREEN (("Alloc 0x%x -> NOSAVE\n", size));
+	    imxExaOffscreenValidate (pScreen);
+	    return NULL;
 	}
     }
 
     /* save extra space in new area */
     if (real_size < area->size)
     {
-	ExaOffscreenArea   *new_area = malloc (sizeof (ExaOffscreenArea));
+	ExaOffscreenArea   *new_area = imxExaOffscreenAllocRec (imxExaPtr);
 	if (!new_area)
 	    return NULL;
+	imxExaOffscreenFreeListRemove (imxExaPtr, area);
 	new_area->base_offset = area->base_offset;
 
 	new_area->offset = new_area->base_offset;
@@ -377,8 +990,12 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
 	area->prev = new_area;
 	area->base_offset = new_area->base_offset + new_area->size;
 	area->size = real_size;
+	imxExaOffscreenFreeListAdd (imxExaPtr, new_area);
     } else
+    {
+	imxExaOffscreenFreeListRemove (imxExaPtr, area);
 	imxExaPtr->numOffscreenAvailable--;
+    }
 
     /*
      * Mark this area as in use
@@ -390,6 +1007,8 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
     area->privData = privData;
     area->save = save;
     area->last_use = imxExaPtr->offScreenCounter++;
+    IMX_EXA_AREA (area)->uses = 0;
+    IMX_EXA_AREA (area)->counted = area->last_use;
     area->offset = (area->base_offset + align - 1);
     area->offset -= area->offset % align;
     area->align = align;
@@ -401,6 +1020,194 @@ imxExaOffscreenAlloc (ScreenPtr pScreen, int size, int align,
     return area;
 }
 
+/*
+ * slide the area after a free one down to the start of the free space,
+ * moving the free space up past it; FALSE if the area cannot move
+ */
+static Bool
+imxExaOffscreenSlide (ScreenPtr pScreen, ImxExaPtr imxExaPtr,
+		      ExaOffscreenArea *hole, ImxExaOffscreenMoveProc move)
+{
+    ExaOffscreenArea *area = hole->next;
+    ExaOffscreenArea *after = area->next;
+    unsigned char *base = imxExaPtr->exaDriverPtr->memoryBase;
+    int used, offset, size, space;
+
+    if (area->state != ExaOffscreenRemovable ||
+	area->size > IMX_EXA_COMPACT_MOVE_MAX)
+	return FALSE;
+
+    /* same alignment at the new place, the free space must not vanish */
+    used = area->size - (area->offset - area->base_offset);
+    offset = hole->base_offset + area->align - 1;
+    offset -= offset % area->align;
+    size = offset - hole->base_offset + used;
+    space = hole->size + area->size;
+    if (size >= space)
+	return FALSE;
+
+    DBG_OFFSCREEN (("Move 0x%x -> 0x%x (0x%x)\n", area->offset, offset,
+		    used));
+    imx_copy_sw_overlap_8 (base + offset, base + area->offset,
+			   used, 1, used, used);
+
+    /* swap the two in the list */
+    imxExaOffscreenFreeListRemove (imxExaPtr, hole);
+    area->prev = hole->prev;
+    if (hole == imxExaPtr->offScreenAreas)
+	imxExaPtr->offScreenAreas = area;
+    else
+	hole->prev->next = area;
+    area->next = hole;
+    hole->prev = area;
+    hole->next = after;
+    if (after)
+	after->prev = hole;
+    else
+	imxExaPtr->offScreenAreas->prev = hole;
+
+    area->base_offset = hole->base_offset;
+    area->offset = offset;
+    area->size = size;
+    hole->base_offset = area->base_offset + size;
+    hole->offset = hole->base_offset;
+    hole->size = space - size;
+
+    if (after && after->state == ExaOffscreenAvail)
+    {
+	imxExaOffscreenFreeListRemove (imxExaPtr, after);
+	imxExaOffscreenMerge (imxExaPtr, hole);
+    }
+    imxExaOffscreenFreeListAdd (imxExaPtr, hole);
+
+    /* tell the owners where their pixels went */
+    if (area->save == imxExaOffscreenSlabSave)
+    {
+	ImxExaOffscreenSlabPtr slab = area->privData;
+	uint32_t slots;
+
+	for (slots = slab->used; slots; slots &= slots - 1)
+	{
+	    int i = __builtin_ctz (slots);
+	    ExaOffscreenArea *slot = &slab->slots[i].area;
+
+	    slot->base_offset = area->offset + i * slab->slotSize;
+	    slot->offset = slot->base_offset;
+	    (*move) (pScreen, slot);
+	}
+    }
+    else
+	(*move) (pScreen, area);
+
+    return TRUE;
+}
+
+/**
+ * imxExaOffscreenCompact moves allocations down into the free space
+ * below them, lowest first.
+ *
+ * @param pScreen current screen
+ * @param move callback for each moved area, and each slot of moved slabs
+ * @param deadline time, from GetTimeInMillis, to stop at
+ *
+ * Only removable areas move, since the pixels of locked ones are in use.
+ * The caller must make sure nothing still refers to the pixels at their
+ * old place once move has been called.
+ *
+ * @return TRUE if more can be done, FALSE once the free space is in one
+ * area at the end or nothing more can move.
+ */
+Bool
+imxExaOffscreenCompact (ScreenPtr pScreen, ImxExaOffscreenMoveProc move,
+			CARD32 deadline)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    ImxPtr imxPtr = IMXPTR(pScrn);
+    ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
+    ExaOffscreenArea *area = NULL;
+    ImxExaOffscreenAreaPtr rec;
+    int sizeClass;
+
+    imxExaOffscreenValidate (pScreen);
+    imxExaOffscreenSlabSync (imxExaPtr);
+
+    /* start at the lowest free area, the first of one of the lists */
+    for (sizeClass = 0; sizeClass < IMX_EXA_OFFSCREEN_CLASSES; sizeClass++)
+    {
+	rec = imxExaPtr->offScreenFree[sizeClass];
+	if (rec && (!area || rec->area.base_offset < area->base_offset))
+	    area = &rec->area;
+    }
+
+    while (area && area->next)
+    {
+	if ((int) (GetTimeInMillis () - deadline) >= 0)
+	{
+	    imxExaOffscreenValidate (pScreen);
+	    return TRUE;
+	}
+
+	/* the free area moves up with each slide, else try the next one */
+	if (area->state != ExaOffscreenAvail ||
+	    !imxExaOffscreenSlide (pScreen, imxExaPtr, area, move))
+	    area = area->next;
+    }
+
+    imxExaOffscreenValidate (pScreen);
+    return FALSE;
+}
+
+/**
+ * imxExaOffscreenMarkUsed records a use of an allocation, for the
+ * eviction policy.  It takes the driver private rather than the screen
+ * as it is called for every operation.
+ */
+void
+imxExaOffscreenMarkUsed (ImxExaPtr imxExaPtr, ExaOffscreenArea *area)
+{
+    area->last_use = imxExaPtr->offScreenCounter++;
+    (*imxExaPtr->offScreenPolicy->used) (IMX_EXA_AREA (area),
+					 area->last_use);
+    imxExaPtr->offScreenHits++;
+}
+
+/**
+ * imxExaOffscreenSetPolicy chooses the eviction policy by name, or the
+ * default one for NULL.
+ *
+ * @return FALSE, leaving the policy as it was, if there is no such policy.
+ */
+Bool
+imxExaOffscreenSetPolicy (ScreenPtr pScreen, const char *name)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    ImxPtr imxPtr = IMXPTR(pScrn);
+    ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
+    int i;
+
+    for (i = 0; i < sizeof (imxExaOffscreenPolicies) /
+		    sizeof (imxExaOffscreenPolicies[0]); i++)
+    {
+	if (!name || !xf86NameCmp (name, imxExaOffscreenPolicies[i].name))
+	{
+	    imxExaPtr->offScreenPolicy = &imxExaOffscreenPolicies[i];
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+const char *
+imxExaOffscreenPolicyName (ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    ImxPtr imxPtr = IMXPTR(pScrn);
+    ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
+
+    return imxExaPtr->offScreenPolicy->name;
+}
+
 void
 imxExaOffscreenSwapIn (ScreenPtr pScreen)
 {
@@ -422,12 +1229,20 @@ imxExaOffscreenInit (ScreenPtr pScreen)
     ImxPtr imxPtr = IMXPTR(pScrn);
     ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
     ExaOffscreenArea *area;
+    int count;
+
+    /* Set up the area records */
+    imxExaPtr->offScreenChunks = NULL;
+    imxExaPtr->offScreenSpare = NULL;
+    count = (imxExaPtr->exaDriverPtr->memorySize -
+	     imxExaPtr->exaDriverPtr->offScreenBase) / IMX_EXA_AREA_GRANULE;
+    if (count < IMX_EXA_AREA_CHUNK)
+	count = IMX_EXA_AREA_CHUNK;
+    if (!imxExaOffscreenGrowRecs (imxExaPtr, count))
+	return FALSE;
 
     /* Allocate a big free area */
-    area = malloc (sizeof (ExaOffscreenArea));
-
-    if (!area)
-	return FALSE;
+    area = imxExaOffscreenAllocRec (imxExaPtr);
 
     area->state = ExaOffscreenAvail;
     area->base_offset = imxExaPtr->exaDriverPtr->offScreenBase;
@@ -444,6 +1259,13 @@ imxExaOffscreenInit (ScreenPtr pScreen)
     imxExaPtr->offScreenAreas = area;
     imxExaPtr->offScreenCounter = 1;
     imxExaPtr->numOffscreenAvailable = 1;
+    imxExaPtr->offScreenFragmented = FALSE;
+    memset (imxExaPtr->offScreenFree, 0, sizeof (imxExaPtr->offScreenFree));
+    imxExaPtr->offScreenFreeClasses = 0;
+    imxExaOffscreenFreeListAdd (imxExaPtr, area);
+    memset (imxExaPtr->offScreenSlabs, 0, sizeof (imxExaPtr->offScreenSlabs));
+    if (!imxExaPtr->offScreenPolicy)
+	imxExaOffscreenSetPolicy (pScreen, NULL);
 
     imxExaOffscreenValidate (pScreen);
 
@@ -457,13 +1279,27 @@ imxExaOffscreenFini (ScreenPtr pScreen)
     ImxPtr imxPtr = IMXPTR(pScrn);
     ImxExaPtr imxExaPtr = IMXEXAPTR(imxPtr);
     ExaOffscreenArea *area;
+    ImxExaOffscreenChunkPtr chunk;
+
+    /* free the slabs, then all of the area records at once */
+    for (area = imxExaPtr->offScreenAreas; area; area = area->next)
+    {
+	if (area->state != ExaOffscreenAvail &&
+	    area->save == imxExaOffscreenSlabSave)
+	    free (area->privData);
+    }
+    imxExaPtr->offScreenAreas = NULL;
 
-    /* just free all of the area records */
-    while ((area = imxExaPtr->offScreenAreas))
+    while ((chunk = imxExaPtr->offScreenChunks))
     {
-	imxExaPtr->offScreenAreas = area->next;
-	free (area);
+	imxExaPtr->offScreenChunks = chunk->next;
+	free (chunk);
     }
+    imxExaPtr->offScreenSpare = NULL;
+    memset (imxExaPtr->offScreenSlabs, 0, sizeof (imxExaPtr->offScreenSlabs));
+    memset (imxExaPtr->offScreenFree, 0, sizeof (imxExaPtr->offScreenFree));
+    imxExaPtr->offScreenFreeClasses = 0;
+    imxExaPtr->offScreenFragmented = FALSE;
 }
 
 /**
@@ -491,7 +1327,9 @@ imxExaOffscreenSwapOut (ScreenPtr pScreen)
 		break;
 	}
 	assert (area->state != ExaOffscreenAvail);
-	(void) imxExaOffscreenKickOut (pScreen, area);
+	/* the memory is going away, saved or not */
+	if (!imxExaOffscreenKickOut (pScreen, area))
+	    (void) imxExaOffscreenFree (pScreen, area);
 	imxExaOffscreenValidate (pScreen);
     }
     imxExaOffscreenValidate (pScreen);
@@ -27,19 +27,48 @@
 #include <X11/Xproto.h>
 #include <dixstruct.h>
 #include <extension.h>
+#include <resource.h>
 #include <string.h>
 
 #include "xf86.h"
 
+#include "imx_epdc.h"
 #include "imx_ext.h"
 
 static DISPATCH_PROC(Proc_IMX_EXT_Dispatch);
 static DISPATCH_PROC(Proc_IMX_EXT_GetPixmapPhysAddr);
+static DISPATCH_PROC(Proc_IMX_EXT_EPDCWaitUpdate);
+static DISPATCH_PROC(Proc_IMX_EXT_EPDCGetStats);
 static DISPATCH_PROC(SProc_IMX_EXT_Dispatch);
 static DISPATCH_PROC(SProc_IMX_EXT_GetPixmapPhysAddr);
+static DISPATCH_PROC(SProc_IMX_EXT_EPDCWaitUpdate);
+static DISPATCH_PROC(SProc_IMX_EXT_EPDCGetStats);
+
+/* Client put to sleep until an EPDC update completes */
+typedef struct {
+	ClientPtr	client;
+	XID		id;
+	ScreenPtr	pScreen;
+} IMX_EXT_EPDCWaitRec, *IMX_EXT_EPDCWaitPtr;
+
+/* Resource type that frees a wait when its client goes away */
+static RESTYPE RT_IMX_EXT_EPDCWait;
+
+static int
+IMX_EXT_EPDCWaitDelete(pointer value, XID id)
+{
+	IMX_EXT_EPDCWaitPtr pWait = value;
+
+	imxEpdcCancelNotifyUpdate(pWait->pScreen, pWait);
+	free(pWait);
+	return Success;
+}
 
 void imxExtInit()
 {
+	RT_IMX_EXT_EPDCWait =
+		CreateNewResourceType(IMX_EXT_EPDCWaitDelete, "IMXEPDCWait");
+
 	AddExtension(
 		IMX_EXT_NAME,
 		0, 0,
@@ -90,6 +119,139 @@ Proc_IMX_EXT_GetPixmapPhysAddr(ClientPtr client)
 	return client->noClientException;
 }
 
+static void
+IMX_EXT_EPDCWaitReply(ClientPtr client, CARD32 updateMarker)
+{
+	/* Initialize reply */
+	xIMX_EXT_EPDCWaitUpdateReply rep;
+	memset(&rep, 0, sizeof(rep));
+	rep.type = X_Reply;
+	rep.sequenceNumber = client->sequence;
+	rep.length = 0;
+	rep.updateMarker = updateMarker;
+
+	/* Check if any reply values need byte swapping */
+	if (client->swapped) {
+
+		swaps(&rep.sequenceNumber);
+		swapl(&rep.length);
+		swapl(&rep.updateMarker);
+	}
+
+	/* Reply to client */
+	WriteToClient(client, sizeof(rep), (char*)&rep);
+}
+
+static void
+IMX_EXT_EPDCWaitDone(pointer closure, CARD32 marker)
+{
+	IMX_EXT_EPDCWaitPtr pWait = closure;
+
+	/* The client is still asleep on the request, so its sequence */
+	/* number is the one the reply belongs to. */
+	IMX_EXT_EPDCWaitReply(pWait->client, marker);
+	AttendClient(pWait->client);
+
+	/* Frees pWait */
+	FreeResource(pWait->id, RT_NONE);
+}
+
+static int
+Proc_IMX_EXT_EPDCWaitUpdate(ClientPtr client)
+{
+	REQUEST(xIMX_EXT_EPDCWaitUpdateReq);
+	REQUEST_SIZE_MATCH(xIMX_EXT_EPDCWaitUpdateReq);
+
+	/* The drawable selects the screen */
+	DrawablePtr pDrawable;
+	int rc = dixLookupDrawable(&pDrawable, stuff->drawable, client, 0,
+					DixGetAttrAccess);
+	if (Success != rc) {
+		return rc;
+	}
+	ScreenPtr pScreen = pDrawable->pScreen;
+
+	/* Make sure everything drawn so far has been sent */
+	CARD32 marker = imxEpdcFlushUpdates(pScreen);
+	if (0 != stuff->updateMarker) {
+		marker = stuff->updateMarker;
+	}
+
+	IMX_EXT_EPDCWaitPtr pWait = malloc(sizeof(IMX_EXT_EPDCWaitRec));
+	if (NULL == pWait) {
+		return BadAlloc;
+	}
+	pWait->client = client;
+	pWait->id = FakeClientID(client->index);
+	pWait->pScreen = pScreen;
+	if (!AddResource(pWait->id, RT_IMX_EXT_EPDCWait, pWait)) {
+		return BadAlloc;
+	}
+
+	/* Sleep until the update completes rather than blocking the */
+	/* server; the reply is sent when the client is woken up. */
+	IgnoreClient(client);
+	if (!imxEpdcNotifyUpdate(pScreen, marker, IMX_EXT_EPDCWaitDone,
+					pWait)) {
+
+		/* Not an EPDC screen, so there is nothing to wait for */
+		IMX_EXT_EPDCWaitDone(pWait, 0);
+	}
+
+	return Success;
+}
+
+static int
+Proc_IMX_EXT_EPDCGetStats(ClientPtr client)
+{
+	REQUEST(xIMX_EXT_EPDCGetStatsReq);
+	REQUEST_SIZE_MATCH(xIMX_EXT_EPDCGetStatsReq);
+
+	/* The drawable selects the screen */
+	DrawablePtr pDrawable;
+	int rc = dixLookupDrawable(&pDrawable, stuff->drawable, client, 0,
+					DixGetAttrAccess);
+	if (Success != rc) {
+		return rc;
+	}
+
+	/* Only screens with an EPDC update engine have stats */
+	ImxEpdcStatsRec stats;
+	if (!imxEpdcGetStats(pDrawable->pScreen, &stats)) {
+		return BadMatch;
+	}
+
+	/* Initialize reply */
+	xIMX_EXT_EPDCGetStatsReply rep;
+	rep.type = X_Reply;
+	rep.updatesInFlight = stats.updatesInFlight;
+	rep.sequenceNumber = client->sequence;
+	rep.length = 0;
+	rep.updateRate = stats.updateRate;
+	rep.updatesSent = stats.updatesSent;
+	rep.updatesPostponed = stats.updatesPostponed;
+	rep.updatesPaced = stats.updatesPaced;
+	rep.updatesFastPath = stats.updatesFastPath;
+	rep.fullRefreshes = stats.fullRefreshes;
+
+	/* Check if any reply values need byte swapping */
+	if (client->swapped) {
+
+		swaps(&rep.sequenceNumber);
+		swapl(&rep.length);
+		swapl(&rep.updateRate);
+		swapl(&rep.updatesSent);
+		swapl(&rep.updatesPostponed);
+		swapl(&rep.updatesPaced);
+		swapl(&rep.updatesFastPath);
+		swapl(&rep.fullRefreshes);
+	}
+
+	/* Reply to client */
+	WriteToClient(client, sizeof(rep), (char*)&rep);
+	return Success;
+}
+
 static int
 Proc_IMX_EXT_Dispatch(ClientPtr client)
 {
@@ -98,6 +260,10 @@ Proc_IMX_EXT_Dispatch(ClientPtr client)
 	{
 		case X_IMX_EXT_GetPixmapPhysAddr:
 			return Proc_IMX_EXT_GetPixmapPhysAddr(client);
+		case X_IMX_EXT_EPDCWaitUpdate:
+			return Proc_IMX_EXT_EPDCWaitUpdate(client);
+		case X_IMX_EXT_EPDCGetStats:
+			return Proc_IMX_EXT_EPDCGetStats(client);
 		default:
 			return BadRequest;
 	}
@@ -118,6 +284,37 @@ SProc_IMX_EXT_GetPixmapPhysAddr(ClientPtr client)
 	return Proc_IMX_EXT_GetPixmapPhysAddr(client);
 }
 
+static int
+SProc_IMX_EXT_EPDCWaitUpdate(ClientPtr client)
+{
+	REQUEST(xIMX_EXT_EPDCWaitUpdateReq);
+
+	/* Swap request message length and verify it is correct. */
+	swaps(&stuff->length);
+	REQUEST_SIZE_MATCH(xIMX_EXT_EPDCWaitUpdateReq);
+
+	/* Swap remaining request message parameters. */
+	swapl(&stuff->drawable);
+	swapl(&stuff->updateMarker);
+
+	return Proc_IMX_EXT_EPDCWaitUpdate(client);
+}
+
+static int
+SProc_IMX_EXT_EPDCGetStats(ClientPtr client)
+{
+	REQUEST(xIMX_EXT_EPDCGetStatsReq);
+
+	/* Swap request message length and verify it is correct. */
+	swaps(&stuff->length);
+	REQUEST_SIZE_MATCH(xIMX_EXT_EPDCGetStatsReq);
+
+	/* Swap remaining request message parameters. */
+	swapl(&stuff->drawable);
+
+	return Proc_IMX_EXT_EPDCGetStats(client);
+}
+
 static int
 SProc_IMX_EXT_Dispatch(ClientPtr client)
 {
@@ -126,6 +323,10 @@ SProc_IMX_EXT_Dispatch(ClientPtr client)
 	{
 		case X_IMX_EXT_GetPixmapPhysAddr:
 			return SProc_IMX_EXT_GetPixmapPhysAddr(client);
+		case X_IMX_EXT_EPDCWaitUpdate:
+			return SProc_IMX_EXT_EPDCWaitUpdate(client);
+		case X_IMX_EXT_EPDCGetStats:
+			return SProc_IMX_EXT_EPDCGetStats(client);
 		default:
 			return BadRequest;
 	}
@@ -26,6 +26,7 @@
 #define __IMX_EXT_H__
 
 #define	Pixmap	CARD32
+#define	Drawable	CARD32
 
 #if !defined(IMX_EXT_NAME)
 #define	IMX_EXT_NAME	"imx-ext"
@@ -35,6 +36,8 @@
 #define	IMX_EXT_NumEvents	0
 
 #define	X_IMX_EXT_GetPixmapPhysAddr	1
+#define	X_IMX_EXT_EPDCWaitUpdate	2
+#define	X_IMX_EXT_EPDCGetStats		3
 
 /************************************************************************/
 
@@ -69,6 +72,56 @@ typedef struct {
 
 /************************************************************************/
 
+typedef struct {
+    CARD8	reqType;	/* always XTestReqCode */
+    CARD8	xtReqType;	/* always X_IMX_EXT_EPDCWaitUpdate */
+    CARD16	length B16;
+    Drawable	drawable B32;	/* selects the screen */
+    CARD32	updateMarker B32;	/* 0 waits for everything drawn so far */
+} xIMX_EXT_EPDCWaitUpdateReq;
+#define sz_xIMX_EXT_EPDCWaitUpdateReq 12
+
+typedef struct {
+    CARD8	type;			/* must be X_Reply */
+    CARD8	pad;
+    CARD16	sequenceNumber B16;	/* of last request received by server */
+    CARD32	length B32;		/* 4 byte quantities beyond size of GenericReply */
+    CARD32	updateMarker B32;	/* marker of the update waited for */
+    CARD32	pad0 B32;		/* bytes 13-16 */
+    CARD32	pad1 B32;		/* bytes 17-20 */
+    CARD32	pad2 B32;		/* bytes 21-24 */
+    CARD32	pad3 B32;		/* bytes 25-28 */
+    CARD32	pad4 B32;		/* bytes 29-32 */
+} xIMX_EXT_EPDCWaitUpdateReply;
+#define	sz_xIMX_EXT_EPDCWaitUpdateReply 32
+
+/************************************************************************/
+
+typedef struct {
+    CARD8	reqType;	/* always XTestReqCode */
+    CARD8	xtReqType;	/* always X_IMX_EXT_EPDCGetStats */
+    CARD16	length B16;
+    Drawable	drawable B32;	/* selects the screen */
+} xIMX_EXT_EPDCGetStatsReq;
+#define sz_xIMX_EXT_EPDCGetStatsReq 8
+
+typedef struct {
+    CARD8	type;			/* must be X_Reply */
+    CARD8	updatesInFlight;	/* sent and not yet completed */
+    CARD16	sequenceNumber B16;	/* of last request received by server */
+    CARD32	length B32;		/* 4 byte quantities beyond size of GenericReply */
+    CARD32	updateRate B32;		/* per second and tile, 0 unlimited */
+    CARD32	updatesSent B32;	/* including full refreshes */
+    CARD32	updatesPostponed B32;	/* held back for a collision */
+    CARD32	updatesPaced B32;	/* held back by the update rate */
+    CARD32	updatesFastPath B32;	/* let through after input */
+    CARD32	fullRefreshes B32;	/* to clear ghosting */
+} xIMX_EXT_EPDCGetStatsReply;
+#define	sz_xIMX_EXT_EPDCGetStatsReply 32
+
+/************************************************************************/
+
 #undef Pixmap
+#undef Drawable
 
 #endif
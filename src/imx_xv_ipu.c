@@ -38,8 +38,10 @@
 #include "mxc_ipu_hl_lib.h"
 #include <xorg/fbdevhw.h>
 #include "fb.h"
+#include "damage.h"
 
 #include "imx.h"
+#include "imx_accel.h"
 
 static Bool debug = 0;
 
@@ -384,6 +386,57 @@ MXQueryBestSize
 	*Width  = DrawableWidth;
 	*Height = DrawableHeight;
 }
+/*
+ * Fill the colour key boxes with the CPU fill kernels.  The screen pixmap
+ * is the frame buffer, or the EPDC shadow when there is one, so it can be
+ * written directly without going through a GC.
+ */
+static Bool
+MXFillKeyDirect(ScreenPtr pScreen, CARD32 key, RegionPtr clipboxes)
+{
+	ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+	ImxPtr imxPtr = IMXPTR(pScrn);
+	PixmapPtr pPixmap = (*pScreen->GetScreenPixmap)(pScreen);
+	BoxPtr pbox = REGION_RECTS(clipboxes);
+	int nbox = REGION_NUM_RECTS(clipboxes);
+	const int pitch = pPixmap->devKind;
+	const int bytesPerPixel = pPixmap->drawable.bitsPerPixel >> 3;
+	imx_fill_sw_func fillFunc;
+	unsigned char* pBits;
+
+	switch (pPixmap->drawable.bitsPerPixel) {
+	case 8:
+		fillFunc = imx_fill_sw_8;
+		break;
+	case 16:
+		fillFunc = imx_fill_sw_16;
+		break;
+	case 32:
+		fillFunc = imx_fill_sw_32;
+		break;
+	default:
+		return FALSE;
+	}
+
+	pBits = (0 != imxPtr->epdcShadowBpp) ?
+		imxPtr->epdcShadowMemory : imxPtr->fbMemoryStart;
+	if (NULL == pBits) {
+		return FALSE;
+	}
+
+	for (; nbox > 0; --nbox, ++pbox) {
+
+		(*fillFunc)(
+			pBits + pbox->y1 * pitch + pbox->x1 * bytesPerPixel,
+			pbox->x2 - pbox->x1,
+			pbox->y2 - pbox->y1,
+			pitch,
+			key);
+	}
+
+	return TRUE;
+}
+
 _X_EXPORT void
 xf86XVFillKeyHelper1 (ScreenPtr pScreen, CARD32 key, RegionPtr clipboxes)
 {
@@ -400,6 +453,12 @@ xf86XVFillKeyHelper1 (ScreenPtr pScreen, CARD32 key, RegionPtr clipboxes)
 
 	if(!xf86ScreenToScrn(pScreen)->vtSema) return;
 
+	/* Fill the key straight into the frame buffer when possible */
+	if (MXFillKeyDirect(pScreen, key, clipboxes)) {
+		DamageDamageRegion(root, clipboxes);
+		return;
+	}
+
 	gc = GetScratchGC(root->depth, pScreen);
 	pval[0] = key;
 	pval[1] = IncludeInferiors;